@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark driver for the watch export pipeline: the watch sources are
+ * included here so that their static state can be driven directly, and
+ * every outbox message is acknowledged immediately, so the measure only
+ * covers the watch-side CPU work.
+ */
+
+#include <getopt.h>
+
+#include "health_data.h"
+
+#define main pebble_main
+#include "pebble_health_export.c"
+#undef main
+
+int worker_main(void);
+
+/* 2017-01-01T00:00:00Z */
+#define BENCH_EPOCH 1483228800
+
+static double
+elapsed(const struct timespec *start, const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec)
+	    + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void
+usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-B blocks] [-c] [-d days] [-l permille]"
+	    " [-n] [-o messages] [-r minutes] [-s seed] [-t trace]"
+	    " [-T trace] [-v] [-w]\n"
+	    "  -B blocks  capture the binary blocks of the export\n"
+	    "  -c       use the legacy CSV transfer\n"
+	    "  -d days  number of days of history to export (default 7,"
+	    " at most 365)\n"
+	    "  -l permille  fail that many messages out of 1000\n"
+	    "  -n       send the newest minutes first\n"
+	    "  -o messages  disconnect the phone after that many messages,\n"
+	    "           until the watch is idle\n"
+	    "  -r minutes  export resolution (default 1)\n"
+	    "  -s seed  seed of the synthetic history (default 1)\n"
+	    "  -t trace  replay the minutes of a trace instead\n"
+	    "  -T trace  capture the exported CSV lines into a trace\n"
+	    "  -v       show the watch logs\n"
+	    "  -w       run the background worker before the export\n", name);
+}
+
+int
+main(int argc, char **argv) {
+	struct timespec start, first, end;
+	unsigned days = 7;
+	unsigned resolution = 1;
+	unsigned disconnect_after = 0;
+	bool disconnected = false;
+	bool csv = false;
+	bool newest_first = false;
+	uint32_t latest_after = 0;
+	bool worker = false;
+	const char *trace = 0;
+	FILE *capture = 0;
+	FILE *blocks = 0;
+	int32_t oldest_key = BENCH_EPOCH / 60;
+	int32_t newest_key;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "B:cd:l:no:r:s:t:T:vw")) != -1) {
+		switch (opt) {
+		    case 'B':
+			blocks = fopen(optarg, "wb");
+			if (!blocks) {
+				perror(optarg);
+				return 1;
+			}
+			stub_capture_binary(blocks);
+			break;
+		    case 'c':
+			csv = true;
+			break;
+		    case 'd':
+			days = strtoul(optarg, 0, 10);
+			break;
+		    case 'l':
+			stub_set_loss(strtoul(optarg, 0, 10));
+			break;
+		    case 'n':
+			newest_first = true;
+			break;
+		    case 'o':
+			disconnect_after = strtoul(optarg, 0, 10);
+			break;
+		    case 'r':
+			resolution = strtoul(optarg, 0, 10);
+			break;
+		    case 's':
+			health_data_set_seed(strtoul(optarg, 0, 10));
+			break;
+		    case 't':
+			trace = optarg;
+			break;
+		    case 'T':
+			/* the trace holds the CSV lines */
+			csv = true;
+			capture = fopen(optarg, "w");
+			if (!capture) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		    case 'v':
+			stub_set_log_level(APP_LOG_LEVEL_DEBUG);
+			break;
+		    case 'w':
+			worker = true;
+			break;
+		    default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!days || days > 365) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (trace) {
+		/* export the whole trace, up to its last minute */
+		if (!health_data_load_trace(trace)) return 1;
+		health_data_trace_span(&oldest_key, &newest_key);
+		days = (newest_key - oldest_key) / 1440 + 1;
+		stub_set_now((time_t)(newest_key + 1) * 60);
+	} else {
+		newest_key = BENCH_EPOCH / 60 + days * 1440 - 1;
+		stub_set_now(BENCH_EPOCH + days * 86400);
+	}
+	health_data_capture(capture);
+	persist_write_bool(MESSAGE_KEY_cfgCsvLines, csv);
+	persist_write_int(MESSAGE_KEY_cfgResolution, resolution);
+	persist_write_bool(MESSAGE_KEY_cfgExportOrder, newest_first);
+	if (worker) {
+		/* as left by an earlier export */
+		struct persist_ring staged = { .next_key = oldest_key };
+		persist_ring_save(&staged);
+		worker_main();
+	}
+	init();
+	uint8_t worker_blocks = ring.count;
+	uint8_t offline_staged = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	setup_last_sent(oldest_key - 1);
+	sending_data = true;
+	last_key = 0;
+	send_next_line();
+	clock_gettime(CLOCK_MONOTONIC, &first);
+	for (;;) {
+		/* timers run while the message is in flight */
+		while (stub_run_timers());
+		if (disconnect_after && !disconnected
+		    && stub_stats.messages_sent > disconnect_after) {
+			stub_set_connected(false);
+			disconnected = true;
+		}
+		if (!latest_after && phone.current_key >= (uint32_t)newest_key)
+			latest_after = stub_stats.messages_sent;
+		if (stub_outbox_deliver()) continue;
+		if (!offline) break;
+		/* the watch staged what it could, the phone comes back */
+		offline_staged = staged_blocks;
+		stub_set_connected(true);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	uint32_t minutes = phone.done;
+	double seconds = elapsed(&start, &end);
+
+	printf("history:        %s\n", trace ? trace : "synthetic");
+	printf("format:         %s\n", csv ? "csv" : "binary");
+	printf("order:          %s\n",
+	    newest_first ? "newest first" : "oldest first");
+	printf("resolution:     %u\n", rollup.resolution);
+	printf("days:           %u\n", days);
+	printf("minutes:        %" PRIu32 "\n", minutes);
+	printf("elapsed:        %.6f s\n", seconds);
+	printf("first message:  %.6f s\n", elapsed(&start, &first));
+	printf("staged blocks:  %u by the worker, %u offline (%u left)\n",
+	    (unsigned)worker_blocks, (unsigned)offline_staged,
+	    (unsigned)ring.count);
+	printf("records/sec:    %.0f\n", seconds > 0 ? minutes / seconds : 0);
+	printf("messages:       %" PRIu32 " (%" PRIu32 " failed)\n",
+	    stub_stats.messages_sent, perf_stats.outbox_failures);
+	printf("latest minute:  after %" PRIu32 " messages\n", latest_after);
+	printf("bytes emitted:  %" PRIu64 "\n", stub_stats.bytes_sent);
+	printf("bytes/minute:   %.2f\n",
+	    minutes ? (double)stub_stats.bytes_sent / minutes : 0);
+	printf("output hash:    %08" PRIx32 "\n", stub_stats.output_hash);
+	printf("page loads:     %" PRIu32 "\n", stub_stats.history_calls);
+	printf("page stalls:    %" PRIu16 " (%" PRIu32 " ms)\n",
+	    page_stalls, page_stall_ms);
+	perf_format(stats_text, sizeof stats_text);
+	printf("stages (count, avg/p90/max):\n%s\n", stats_text);
+
+	deinit();
+	if (capture) fclose(capture);
+	if (blocks) fclose(blocks);
+	return (sending_data || gave_up) ? 1 : 0;
+}
@@ -0,0 +1,792 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * End-to-end load test of the phone part: src/pkjs/app.js runs under Node
+ * with stubs of the PebbleKit JS environment, uploading to a local mock of
+ * the ingest endpoint, while a simulated watch feeds it dataKey/dataLine
+ * messages over a simulated Bluetooth link.
+ *
+ * A lost message is sent again by the watch after the retransmission
+ * timeout; a lost acknowledgement makes the watch send again a message
+ * the phone already received, as the AppMessage layer would.
+ *
+ * The endpoint checks the key range and hash sent with each batch, and
+ * acknowledges a batch it already stored without storing it again. With
+ * --response-loss it stores a batch but drops the response, so that the
+ * phone sends it again. With --stored it starts with the first minutes
+ * already stored, which --high-water lets the phone skip by asking for
+ * the last key stored.
+ *
+ * With --trace the watch sends the minutes of a trace file, as captured
+ * by the bench with -T, instead of synthetic ones. With --blocks it sends
+ * the dataBinary blocks captured by the bench with -B instead of CSV
+ * lines, runs and rollups included, resuming from the block holding the
+ * minute after lastSent. The endpoint stores a rollup as its bucket, and
+ * counts the minutes it covers.
+ *
+ * The endpoint decodes gzip bodies, or refuses them with --reject-gzip.
+ * The content hash covers the fields of every minute received, so runs
+ * with and without compression must report the same one.
+ *
+ * With --resend-after, Resend is turned on in the configuration page
+ * after that many watch messages: the watch exports every minute again,
+ * and each minute the endpoint stored before must be stored once more.
+ *
+ * The test fails when a minute is missing, or stored twice.
+ *
+ * Usage: node e2e.js [--option value ...], see OPTIONS below.
+ */
+
+var fs = require("fs");
+var http = require("http");
+var path = require("path");
+var vm = require("vm");
+var zlib = require("zlib");
+
+var PKJS_DIR = path.join(__dirname, "..", "src", "pkjs");
+var wireFormat = require(path.join(PKJS_DIR, "wire_format.js"));
+var ENDPOINT_PATH = "/v1/health_records/batch_create";
+var HIGH_WATER_PATH = "/v1/health_records/high_water";
+/* 2017-01-01T00:00:00Z */
+var EPOCH_KEY = 1483228800 / 60;
+var TRACE_HEADER = "# pebble-health-export trace v1";
+
+var OPTIONS = {
+   "minutes": [10080, "minutes of history to export"],
+   "trace": ["", "export the minutes of this trace file instead"],
+   "blocks": ["", "send the binary blocks of this capture instead"],
+   "lines": [100, "minutes per dataLine message"],
+   "link-latency": [30, "one-way Bluetooth latency, ms"],
+   "loss": [0, "probability of losing a message to the phone"],
+   "ack-loss": [0, "probability of losing the acknowledgement of a message"],
+   "retransmit": [500, "watch retransmission timeout, ms"],
+   "server-latency": [50, "mock endpoint response time, ms"],
+   "server-errors": [0, "probability of a 500 response from the endpoint"],
+   "throttle": [0, "probability of a 429 response with Retry-After: 1"],
+   "response-loss": [0, "probability of dropping the response to a batch"],
+   "stored": [0, "minutes the endpoint already stored"],
+   "high-water": [0, "ask the endpoint for its last key at startup"],
+   "resend-after": [0, "turn on Resend after this many watch messages"],
+   "window": [4, "cfgUploadWindow"],
+   "bundle": [500, "cfgBundleMax"],
+   "flush-delay": [1, "cfgFlushDelay, s"],
+   "format": ["rows", "cfgUploadFormat"],
+   "compress": [0, "cfgUploadCompression"],
+   "reject-gzip": [0, "answer 415 to compressed requests"],
+   "sample": [1000, "queue depth sampling period, ms"],
+   "timeout": [120, "give up after this many seconds"],
+   "seed": [1, "random seed"]
+};
+
+var opt = {};
+
+function usage() {
+   console.error("Usage: node e2e.js [--option value ...]");
+   Object.keys(OPTIONS).forEach(function (name) {
+      console.error("  --" + name + " (" + OPTIONS[name][0] + ")  "
+          + OPTIONS[name][1]);
+   });
+   process.exit(1);
+}
+
+function parseOptions(argv) {
+   Object.keys(OPTIONS).forEach(function (name) {
+      opt[name] = OPTIONS[name][0];
+   });
+   for (var i = 0; i < argv.length; i += 2) {
+      var name = argv[i].replace(/^--/, "");
+      if (!(name in OPTIONS) || i + 1 >= argv.length) usage();
+      opt[name] = typeof OPTIONS[name][0] === "number"
+          ? Number(argv[i + 1]) : argv[i + 1];
+   }
+}
+
+/* random - deterministic generator, so that runs can be compared */
+var seed = 1;
+function random() {
+   seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+   return seed / 0x80000000;
+}
+
+var trace = null;
+
+/* loadTrace - lines of a trace file by key, and its first and last keys */
+function loadTrace(file) {
+   var records = fs.readFileSync(file, "utf8").split("\n");
+   var result = { lines: {}, first_key: Infinity, last_key: -Infinity };
+
+   if (records[0] !== TRACE_HEADER) {
+      console.error(file + ": not a trace");
+      process.exit(1);
+   }
+   for (var i = 1; i < records.length; i++) {
+      if (!records[i] || records[i][0] === "#") continue;
+      var key = parseInt(records[i], 10);
+      var separator = records[i].indexOf(";");
+      if (isNaN(key) || separator < 0) {
+         console.error(file + ":" + (i + 1) + ": bad record");
+         process.exit(1);
+      }
+      result.lines[key] = records[i].slice(separator + 1);
+      result.first_key = Math.min(result.first_key, key);
+      result.last_key = Math.max(result.last_key, key);
+   }
+   if (result.first_key > result.last_key) {
+      console.error(file + ": empty trace");
+      process.exit(1);
+   }
+   return result;
+}
+
+var blocks = null;
+
+/* loadBlocks - dataBinary blocks of a capture, with the first and last */
+/*    minutes of each, and the resolution of their records */
+function loadBlocks(file) {
+   var data = fs.readFileSync(file);
+   var result = { list: [], minutes: 0, resolution: 1 };
+   var offset = 0;
+
+   while (offset + 8 <= data.length) {
+      var size = 8 + data[offset + 3] * (data[offset + 1] === 2 ? 16 : 8);
+      var bytes = Array.prototype.slice.call(data, offset, offset + size);
+      var block;
+      try {
+         block = wireFormat.decode(bytes);
+      } catch (e) {
+         console.error(file + ": offset " + offset + ": " + e.message);
+         process.exit(1);
+      }
+      var n = block.keys.length - 1;
+      if (n >= 0) {
+         result.list.push({ bytes: bytes, first_key: block.keys[0],
+             last_key: block.keys[n] + block.spans[n] - 1 });
+         block.spans.forEach(function (span) { result.minutes += span; });
+         result.resolution = block.resolution || 1;
+      }
+      offset += size;
+   }
+   if (!result.list.length) {
+      console.error(file + ": no blocks");
+      process.exit(1);
+   }
+   result.first_key = result.list[0].first_key;
+   result.last_key = result.list[result.list.length - 1].last_key;
+   return result;
+}
+
+/* minuteLine - CSV line of a minute, as the watch builds them, from */
+/*    the trace or synthetic */
+function minuteLine(key) {
+   var hash = (key * 2654435761) >>> 0;
+   var timestamp = new Date(key * 60000).toISOString()
+       .replace(/\.\d{3}Z$/, "Z");
+
+   /* a minute missing from the trace is an invalid one */
+   if (trace) return trace.lines[key] || timestamp + ",,,,,,0,";
+   if (hash % 97 === 0) return timestamp + ",,,,,,0,";
+   return timestamp + "," + (hash >>> 8) % 120 + "," + (hash >>> 16) % 16
+       + "," + (hash >>> 20) % 16 + "," + (hash >>> 4) % 4000
+       + ",2,0," + (55 + (hash >>> 24) % 60);
+}
+
+/* Mock ingest endpoint, counting every minute it receives */
+
+var server_stats = {
+   requests: 0,
+   active: 0,
+   max_active: 0,
+   errors: 0,
+   minutes: 0,
+   duplicates: 0,
+   bytes: 0,
+   compressed: 0,
+   content_hash: 0,
+   deduplicated: 0,
+   rejected: 0,
+   resending: false,
+   to_resend: [],
+   resent_seen: {},
+   last_key: 0,
+   batches: {},
+   seen: {}
+};
+
+/* bodyRows - timestamp, fields and minutes covered by the rows of a */
+/*    request body, a row per minute or per rollup bucket */
+function bodyRows(body) {
+   var result = [];
+   var i, j, span;
+
+   if (Array.isArray(body)) {
+      for (i = 0; i < body.length; i++) {
+         if (body[i].resolution) {
+            result.push([Date.parse(body[i].timestamp),
+                JSON.stringify(body[i]), parseInt(body[i].resolution, 10)]);
+            continue;
+         }
+         span = parseInt(body[i].minutes || "1", 10);
+         for (j = 0; j < span; j++) {
+            result.push([Date.parse(body[i].timestamp) + j * 60000,
+                JSON.stringify(body[i]), 1]);
+         }
+      }
+      return result;
+   }
+
+   var start = Date.parse(body.start);
+   var fields = Object.keys(body).filter(function (name) {
+      return Array.isArray(body[name]) && name !== "offsets"
+          && name !== "minutes";
+   });
+   for (i = 0; i < body.count; i++) {
+      /* offsets are in minutes, the step in seconds */
+      var t = start + (body.offsets ? body.offsets[i] * 60
+          : i * body.step) * 1000;
+      var values = fields.map(function (name) { return body[name][i]; });
+      if (body.step > 60) {
+         result.push([t, JSON.stringify(values), body.step / 60]);
+         continue;
+      }
+      span = body.minutes ? body.minutes[i] : 1;
+      for (j = 0; j < span; j++) {
+         result.push([t + j * 60000, JSON.stringify(values), 1]);
+      }
+   }
+   return result;
+}
+
+/* fnv1a - 32-bit hash of a string */
+function fnv1a(text) {
+   var hash = 0x811c9dc5;
+   for (var i = 0; i < text.length; i++) {
+      hash = Math.imul(hash ^ text.charCodeAt(i), 0x01000193);
+   }
+   return hash >>> 0;
+}
+
+function hashHex(hash) {
+   return ("0000000" + hash.toString(16)).slice(-8);
+}
+
+function handleRequest(req, res) {
+   var chunks = [];
+
+   server_stats.active += 1;
+   server_stats.max_active = Math.max(server_stats.max_active,
+       server_stats.active);
+   res.on("close", function () { server_stats.active -= 1; });
+   req.on("data", function (chunk) { chunks.push(chunk); });
+   req.on("end", function () {
+      setTimeout(function () {
+         var body;
+
+         server_stats.requests += 1;
+         if (req.method === "GET" && req.url === HIGH_WATER_PATH) {
+            res.writeHead(200, { "Content-Type": "application/json" });
+            res.end(JSON.stringify({ lastKey: server_stats.last_key }));
+            return;
+         }
+         if (req.method !== "POST" || req.url !== ENDPOINT_PATH) {
+            res.writeHead(404);
+            res.end();
+            return;
+         }
+         if (random() < opt["server-errors"]) {
+            server_stats.errors += 1;
+            res.writeHead(500);
+            res.end();
+            return;
+         }
+         if (random() < opt.throttle) {
+            server_stats.errors += 1;
+            res.writeHead(429, { "Retry-After": "1" });
+            res.end();
+            return;
+         }
+
+         var raw = Buffer.concat(chunks);
+         server_stats.bytes += raw.length;
+         if (req.headers["content-encoding"] === "gzip") {
+            if (opt["reject-gzip"]) {
+               res.writeHead(415);
+               res.end();
+               return;
+            }
+            server_stats.compressed += 1;
+         }
+         try {
+            if (req.headers["content-encoding"] === "gzip") {
+               /* checks the CRC and length of the uncompressed body */
+               raw = zlib.gunzipSync(raw);
+            }
+            body = JSON.parse(raw.toString("utf8"));
+         } catch (e) {
+            res.writeHead(400);
+            res.end();
+            return;
+         }
+
+         var keys = req.headers["x-batch-keys"];
+         var batch_hash = req.headers["x-batch-hash"];
+         var rows = bodyRows(body);
+         var first = Infinity, last = -Infinity;
+         rows.forEach(function (row) {
+            first = Math.min(first, row[0] / 60000);
+            last = Math.max(last, row[0] / 60000 + row[2] - 1);
+         });
+         if (keys !== first + "-" + last
+             || batch_hash !== hashHex(fnv1a(raw.toString("utf8")))) {
+            server_stats.rejected += 1;
+            res.writeHead(400);
+            res.end();
+            return;
+         }
+         if (server_stats.batches[keys + "/" + batch_hash]) {
+            /* already stored, the response must have been lost */
+            server_stats.deduplicated += 1;
+            res.writeHead(200, { "Content-Type": "application/json" });
+            res.end("{}");
+            return;
+         }
+         server_stats.batches[keys + "/" + batch_hash] = true;
+         server_stats.last_key = Math.max(server_stats.last_key, last);
+
+         rows.forEach(function (row) {
+            var t = row[0];
+            if (server_stats.resending && server_stats.seen[t]
+                && !server_stats.resent_seen[t]) {
+               /* stored again after Resend */
+               server_stats.resent_seen[t] = true;
+            } else if (server_stats.seen[t]) {
+               server_stats.duplicates += 1;
+            } else {
+               server_stats.seen[t] = true;
+               server_stats.minutes += row[2];
+               server_stats.content_hash = (server_stats.content_hash
+                   + fnv1a(t + " " + row[1])) >>> 0;
+            }
+         });
+         if (random() < opt["response-loss"]) {
+            req.socket.destroy();
+            return;
+         }
+         res.writeHead(201, { "Content-Type": "application/json" });
+         res.end("{}");
+      }, opt["server-latency"]);
+   });
+}
+
+/* PebbleKit JS environment */
+
+function XMLHttpRequest() {
+   this.listeners = {};
+   this.headers = {};
+   this.status = 0;
+   this.statusText = "";
+   this.responseText = "";
+   this.responseHeaders = {};
+   this.timeout = 0;
+   this.request = null;
+   this.timer = null;
+}
+
+XMLHttpRequest.prototype.addEventListener = function (name, callback) {
+   this.listeners[name] = callback;
+};
+
+XMLHttpRequest.prototype.open = function (method, url) {
+   this.method = method;
+   this.url = url;
+};
+
+XMLHttpRequest.prototype.setRequestHeader = function (name, value) {
+   this.headers[name] = value;
+};
+
+XMLHttpRequest.prototype.getResponseHeader = function (name) {
+   var value = this.responseHeaders[name.toLowerCase()];
+   return value === undefined ? null : value;
+};
+
+XMLHttpRequest.prototype.dispatch = function (name) {
+   if (this.timer) clearTimeout(this.timer);
+   this.timer = null;
+   if (this.listeners[name]) this.listeners[name]();
+};
+
+XMLHttpRequest.prototype.send = function (body) {
+   var xhr = this;
+   var url = new URL(this.url);
+
+   this.request = http.request({
+      method: this.method,
+      hostname: url.hostname,
+      port: url.port,
+      path: url.pathname,
+      headers: this.headers
+   }, function (res) {
+      var chunks = [];
+      res.on("data", function (chunk) { chunks.push(chunk); });
+      res.on("end", function () {
+         xhr.request = null;
+         xhr.status = res.statusCode;
+         xhr.statusText = res.statusMessage;
+         xhr.responseHeaders = res.headers;
+         xhr.responseText = Buffer.concat(chunks).toString("utf8");
+         xhr.dispatch("load");
+      });
+   });
+   this.request.on("error", function (e) {
+      if (!xhr.request) return;
+      xhr.request = null;
+      xhr.statusText = e.message;
+      xhr.dispatch("error");
+   });
+   this.request.end(body);
+   if (this.timeout > 0) {
+      this.timer = setTimeout(function () {
+         var request = xhr.request;
+         xhr.request = null;
+         if (request) request.destroy();
+         xhr.statusText = "timeout";
+         xhr.dispatch("timeout");
+      }, this.timeout);
+   }
+};
+
+XMLHttpRequest.prototype.abort = function () {
+   var request = this.request;
+   this.request = null;
+   if (this.timer) clearTimeout(this.timer);
+   this.timer = null;
+   if (request) request.destroy();
+};
+
+function LocalStorage() {
+   this.items = {};
+}
+
+LocalStorage.prototype.getItem = function (name) {
+   return name in this.items ? this.items[name] : null;
+};
+
+LocalStorage.prototype.setItem = function (name, value) {
+   this.items[name] = String(value);
+};
+
+LocalStorage.prototype.removeItem = function (name) {
+   delete this.items[name];
+};
+
+/* messageKeys - ids of the message keys of package.json, as the SDK */
+/*    numbers them */
+function messageKeys() {
+   var names = JSON.parse(fs.readFileSync(path.join(PKJS_DIR, "..", "..",
+       "package.json"), "utf8")).pebble.messageKeys;
+   var keys = {};
+   names.forEach(function (name, i) { keys[name] = 10000 + i; });
+   return keys;
+}
+
+/* keyNames - a message with message key ids replaced by their names */
+function keyNames(message) {
+   var ids = messageKeys();
+   var names = {};
+   var result = {};
+   Object.keys(ids).forEach(function (name) { names[ids[name]] = name; });
+   Object.keys(message).forEach(function (key) {
+      result[key in names ? names[key] : key] = message[key];
+   });
+   return result;
+}
+
+/* loadApp - run app.js in a fresh context, returning the context */
+function loadApp(watch, endpoint) {
+   var listeners = {};
+   var context = {
+      console: { log: function () {} },
+      setTimeout: setTimeout,
+      clearTimeout: clearTimeout,
+      XMLHttpRequest: XMLHttpRequest,
+      localStorage: new LocalStorage(),
+      Pebble: {
+         addEventListener: function (name, callback) {
+            listeners[name] = callback;
+         },
+         sendAppMessage: function (message, success) {
+            setTimeout(function () {
+               watch.receive(keyNames(message));
+               /* the acknowledgement comes back over the same link */
+               if (success) setTimeout(success, opt["link-latency"]);
+            }, opt["link-latency"]);
+         }
+      },
+      listeners: listeners
+   };
+
+   /* Clay, storing the settings of the configuration page, and */
+   /*    returning them by message key id, toggles as numbers */
+   function Clay() {}
+   Clay.prototype.generateUrl = function () { return ""; };
+   Clay.prototype.getSettings = function (response) {
+      var settings = JSON.parse(response);
+      var ids = messageKeys();
+      var result = {};
+      context.localStorage.setItem("clay-settings", response);
+      Object.keys(settings).forEach(function (name) {
+         var value = settings[name];
+         if (typeof value === "boolean") value = value ? 1 : 0;
+         if (name in ids) result[ids[name]] = value;
+      });
+      return result;
+   };
+
+   function requireModule(name) {
+      if (name === "pebble-clay") return Clay;
+      if (name === "message_keys") return messageKeys();
+      var module = { exports: {} };
+      var source = fs.readFileSync(path.join(PKJS_DIR, name), "utf8");
+      vm.runInContext("(function (module, exports, require) {"
+          + source + "\n})", context)(module, module.exports, requireModule);
+      return module.exports;
+   }
+
+   context.require = requireModule;
+   vm.createContext(context);
+   context.localStorage.setItem("clay-settings", JSON.stringify({
+      cfgEndpoint: endpoint,
+      cfgAuthToken: "e2e",
+      cfgBundleMax: opt.bundle,
+      cfgUploadWindow: opt.window,
+      cfgFlushDelay: opt["flush-delay"],
+      cfgUploadFormat: opt.format,
+      cfgUploadCompression: !!opt.compress,
+      cfgHighWaterEndpoint: opt["high-water"]
+          ? endpoint.replace(ENDPOINT_PATH, HIGH_WATER_PATH) : ""
+   }));
+   vm.runInContext(fs.readFileSync(path.join(PKJS_DIR, "app.js"), "utf8"),
+       context, { filename: "app.js" });
+   return context;
+}
+
+/* Simulated watch, sending one message at a time like the outbox */
+
+function Watch(first_key, last_key) {
+   this.app = null;
+   this.first_key = first_key;
+   this.next_key = 0;
+   this.last_key = last_key;
+   this.uploaded = 0;
+   this.messages = 0;
+   this.retransmissions = 0;
+   /* bumped when the export starts over, to stop the previous one */
+   this.generation = 0;
+   /* set by Resend until a message marked as sent after it is acked */
+   this.resend_echo = false;
+   this.in_flight = false;
+}
+
+/* receive - handle a message from the phone */
+Watch.prototype.receive = function (message) {
+   if ("lastSent" in message) {
+      this.next_key = Math.max(this.first_key,
+          parseInt(message.lastSent, 10) + 1);
+      this.send();
+   }
+   if ("uploadDone" in message) {
+      this.uploaded = Math.max(this.uploaded, message.uploadDone);
+   }
+   if (message.resend) {
+      /* the export starts over from the first minute, after the */
+      /*    message in flight if any */
+      this.generation += 1;
+      this.next_key = this.first_key;
+      this.uploaded = 0;
+      this.resend_echo = true;
+      if (!this.in_flight) this.send();
+   }
+};
+
+/* turnOnResend - close the configuration page with Resend turned on */
+Watch.prototype.turnOnResend = function () {
+   var settings = JSON.parse(this.app.localStorage.getItem("clay-settings"));
+
+   server_stats.resending = true;
+   server_stats.to_resend = Object.keys(server_stats.seen);
+   settings.resend = true;
+   this.app.listeners.webviewclosed({ response: JSON.stringify(settings) });
+};
+
+/* message - payload of the next message, and the key following it */
+Watch.prototype.message = function () {
+   var key = this.next_key;
+   var count = Math.min(opt.lines, this.last_key - key + 1);
+   var lines = [];
+
+   if (blocks) {
+      for (var b = 0; b < blocks.list.length; b++) {
+         var block = blocks.list[b];
+         if (block.last_key < key) continue;
+         return { payload: { dataBinary: block.bytes },
+             next_key: block.last_key + 1 };
+      }
+   }
+   for (var i = 0; i < count; i++) {
+      lines.push(minuteLine(key + i));
+   }
+   return { payload: { dataKey: key, dataLine: lines.join("\n") },
+       next_key: key + count };
+};
+
+/* send - transmit the next message, then wait for its acknowledgement */
+Watch.prototype.send = function () {
+   if (this.next_key > this.last_key) return;
+
+   var watch = this;
+   var message = this.message();
+   var generation = this.generation;
+
+   if (this.resend_echo) message.payload.resend = 1;
+   this.in_flight = true;
+   this.messages += 1;
+   if (this.messages === opt["resend-after"]) this.turnOnResend();
+   if (random() < opt.loss) {
+      this.retransmit();
+      return;
+   }
+
+   setTimeout(function () {
+      watch.app.listeners.appmessage({ payload: message.payload });
+      if (random() < opt["ack-loss"]) {
+         watch.retransmit();
+         return;
+      }
+      setTimeout(function () {
+         watch.in_flight = false;
+         if (generation === watch.generation) {
+            watch.next_key = message.next_key;
+            if (message.payload.resend) watch.resend_echo = false;
+         }
+         watch.send();
+      }, opt["link-latency"]);
+   }, opt["link-latency"]);
+};
+
+Watch.prototype.retransmit = function () {
+   var watch = this;
+   this.retransmissions += 1;
+   /* after Resend, the failed message is replaced by the first one */
+   setTimeout(function () {
+      watch.in_flight = false;
+      watch.send();
+   }, opt.retransmit);
+};
+
+function main() {
+   parseOptions(process.argv.slice(2));
+   seed = opt.seed;
+
+   var first_key = EPOCH_KEY;
+   var resolution = 1;
+   if (opt.trace) {
+      trace = loadTrace(opt.trace);
+      first_key = trace.first_key;
+      opt.minutes = trace.last_key - first_key + 1;
+   }
+   var last_key = first_key + opt.minutes - 1;
+   if (opt.blocks) {
+      blocks = loadBlocks(opt.blocks);
+      first_key = blocks.first_key;
+      last_key = blocks.last_key;
+      opt.minutes = blocks.minutes;
+      resolution = blocks.resolution;
+   }
+   var watch = new Watch(first_key, last_key);
+   var server = http.createServer(handleRequest);
+
+   /* only whole buckets are stored, the high water mark may fall */
+   /*    inside the next one */
+   for (var key = first_key; key + resolution <= first_key + opt.stored;
+       key += resolution) {
+      server_stats.seen[key * 60000] = true;
+      server_stats.minutes += resolution;
+   }
+   if (opt.stored > 0) server_stats.last_key = first_key + opt.stored - 1;
+
+   server.listen(0, "127.0.0.1", function () {
+      var endpoint = "http://127.0.0.1:" + server.address().port
+          + ENDPOINT_PATH;
+      var started = Date.now();
+      var depths = [];
+      var max_depth = 0;
+
+      watch.app = loadApp(watch, endpoint);
+      watch.app.listeners.ready();
+
+      var sampler = setInterval(function () {
+         var depth = watch.app.to_send.length();
+         depths.push(depth);
+         max_depth = Math.max(max_depth, depth);
+      }, opt.sample);
+
+      var checker = setInterval(function () {
+         var seconds = (Date.now() - started) / 1000;
+         var finished = watch.uploaded >= last_key;
+         var resent = server_stats.to_resend.filter(function (t) {
+            return server_stats.resent_seen[t];
+         }).length;
+         if (!finished && seconds < opt.timeout) return;
+
+         clearInterval(sampler);
+         clearInterval(checker);
+         server.close();
+
+         console.log("minutes:          " + opt.minutes);
+         console.log("uploaded:         " + server_stats.minutes
+             + (finished ? "" : " (timed out)"));
+         console.log("missing:          "
+             + (opt.minutes - server_stats.minutes));
+         console.log("elapsed:          " + seconds.toFixed(3) + " s");
+         console.log("minutes/sec:      "
+             + Math.round(server_stats.minutes / seconds));
+         console.log("watch messages:   " + watch.messages
+             + " (" + watch.retransmissions + " retransmitted)");
+         console.log("requests:         " + server_stats.requests
+             + " (" + server_stats.errors + " failed, "
+             + server_stats.max_active + " at most at once)");
+         console.log("request bytes:    " + server_stats.bytes
+             + " (" + server_stats.compressed + " requests compressed)");
+         console.log("duplicates:       " + server_stats.duplicates
+             + " (" + server_stats.deduplicated + " batches deduplicated, "
+             + server_stats.rejected + " rejected)");
+         if (server_stats.resending)
+            console.log("stored again:     " + resent
+                + " of " + server_stats.to_resend.length + " after Resend");
+         console.log("content hash:     "
+             + hashHex(server_stats.content_hash));
+         console.log("max queue depth:  " + max_depth);
+         console.log("queue depth:      " + depths.join(" "));
+         console.log("phone statistics: " + watch.app.stats);
+         process.exit(server_stats.minutes >= opt.minutes
+             && !server_stats.duplicates
+             && resent === server_stats.to_resend.length ? 0 : 1);
+      }, 50);
+   });
+}
+
+main();
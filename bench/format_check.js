@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Check of the batching of src/pkjs/upload_format.js: a queue mixing
+ * minutes, runs and rollups of two resolutions is cut into batches with
+ * uniformCount, and each batch must build into a columns body whose step
+ * matches all of its records.
+ *
+ * Usage: node format_check.js
+ */
+
+var path = require("path");
+
+var PKJS_DIR = path.join(__dirname, "..", "src", "pkjs");
+var uploadFormat = require(path.join(PKJS_DIR, "upload_format.js"));
+var wireFormat = require(path.join(PKJS_DIR, "wire_format.js"));
+/* 2017-01-01T00:00:00Z */
+var EPOCH_KEY = 1483228800 / 60;
+
+/* minute, run and rollup records, as queued by the phone */
+function minute(key) {
+   return key + ";" + wireFormat.timestamp(key) + ",12,20,30,400,5,1,70";
+}
+
+function run(key, span) {
+   return minute(key) + ";" + span;
+}
+
+function rollup(key, resolution) {
+   return key + ";" + wireFormat.timestamp(key)
+       + ",0,120,4000,600,60,70,80,1,5;r" + resolution;
+}
+
+/* queue - the records of the check, in upload order */
+function queue() {
+   var records = [];
+   var key = EPOCH_KEY;
+   var i;
+
+   for (i = 0; i < 3; i++, key++) records.push(minute(key));
+   records.push(run(key, 4));
+   key += 4;
+   for (i = 0; i < 3; i++, key += 15) records.push(rollup(key, 15));
+   for (i = 0; i < 2; i++, key += 30) records.push(rollup(key, 30));
+   records.push(rollup(key, 15));
+   key += 15;
+   records.push(minute(key));
+   return records;
+}
+
+function check() {
+   var records = queue();
+   var expected = [[1, 4], [15, 3], [30, 2], [15, 1], [1, 1]];
+   var failures = 0;
+   var offset = 0;
+
+   function get(i) {
+      return records[offset + i];
+   }
+
+   expected.forEach(function (batch) {
+      var step = batch[0] * 60;
+      var count, body;
+
+      if (offset >= records.length) {
+         console.log("no records left for a batch with step " + step);
+         failures++;
+         return;
+      }
+      count = uploadFormat.uniformCount(get, records.length - offset);
+      body = JSON.parse(uploadFormat.build("columns",
+          records.slice(offset, offset + count), true));
+      if (count !== batch[1] || body.step !== step || body.offsets) {
+         console.log("batch at " + offset + ": " + count
+             + " records with step " + body.step + (body.offsets
+             ? " and offsets" : "") + ", expected " + batch[1]
+             + " with step " + step);
+         failures++;
+      }
+      offset += count;
+   });
+   if (offset !== records.length) {
+      console.log(records.length - offset + " records left");
+      failures++;
+   }
+   return failures;
+}
+
+var failures = check();
+console.log(failures ? failures + " checks failed" : "upload format ok");
+process.exit(failures ? 1 : 0);
@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Synthetic days are planned from the seed and the day number alone, so
+ * that any minute can be computed without the ones before it: a night of
+ * sleep from the evening before, with restful phases, a few walks, now and
+ * then a run or a workout, the watch off the wrist while charging and on
+ * rare days for hours, and sporadic invalid minutes. The heart rate
+ * follows a resting rate drawn for each day, lower while asleep and
+ * higher with the effort.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "health_data.h"
+
+#define DAY_MINUTES 1440
+/* minutes from midnight after which nothing but sleep is planned */
+#define EVENING (21 * 60 + 30)
+#define PLAN_INTERVALS 24
+#define PLAN_GAPS 2
+#define ACTIVITY_BITS 5
+
+struct interval {
+	HealthActivity	activity;
+	int16_t		start;	/* minutes from the midnight of the day */
+	int16_t		end;
+};
+
+/* day_plan - a synthetic day, from the sleep begun the evening before */
+struct day_plan {
+	int32_t		day;
+	bool		planned;
+	int16_t		bed;	/* negative before midnight */
+	int16_t		wake;
+	uint8_t		hr_rest;
+	uint8_t		activity_count;
+	uint8_t		gap_count;
+	struct interval	activity[PLAN_INTERVALS];
+	struct interval	gap[PLAN_GAPS];	/* off the wrist */
+};
+
+struct trace_interval {
+	HealthActivity	activity;
+	int32_t		first_key;
+	int32_t		end_key;
+};
+
+static uint32_t seed = 1;
+static struct day_plan plans[2];
+
+static struct {
+	bool			loaded;
+	int32_t			first_key;
+	uint32_t		count;
+	HealthMinuteData	*minutes;
+	uint8_t			*masks;
+	struct trace_interval	*intervals;
+	uint32_t		interval_count;
+} trace;
+
+static FILE *capture = 0;
+
+/* mix - integer hash, the lowbias32 finalizer */
+static uint32_t
+mix(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+/* draw - next random number below range from the state */
+static uint32_t
+draw(uint32_t *state, uint32_t range) {
+	*state = mix(*state + 0x9e3779b9);
+	return range ? *state % range : *state;
+}
+
+void
+health_data_set_seed(uint32_t new_seed) {
+	seed = new_seed;
+	plans[0].planned = plans[1].planned = false;
+}
+
+static bool
+overlaps(const struct interval *list, uint8_t count, int16_t start,
+    int16_t end) {
+	for (uint8_t i = 0; i < count; i += 1) {
+		if (start < list[i].end && list[i].start < end) return true;
+	}
+	return false;
+}
+
+static void
+add_activity(struct day_plan *plan, HealthActivity activity, int16_t start,
+    int16_t end) {
+	if (plan->activity_count >= PLAN_INTERVALS || start >= end) return;
+	plan->activity[plan->activity_count++] = (struct interval)
+	    { activity, start, end };
+}
+
+/* add_daytime - plan an activity, unless the watch is off the wrist */
+/*    or another activity is going on */
+static void
+add_daytime(struct day_plan *plan, uint8_t first_daytime,
+    HealthActivity activity, int16_t start, int16_t end) {
+	if (overlaps(plan->gap, plan->gap_count, start, end)
+	    || overlaps(plan->activity + first_daytime,
+	    plan->activity_count - first_daytime, start, end))
+		return;
+	add_activity(plan, activity, start, end);
+}
+
+static void
+add_gap(struct day_plan *plan, int16_t start, int16_t end) {
+	if (end > DAY_MINUTES) end = DAY_MINUTES;
+	if (plan->gap_count >= PLAN_GAPS || start >= end) return;
+	plan->gap[plan->gap_count++] = (struct interval)
+	    { HealthActivityNone, start, end };
+}
+
+static int
+compare_intervals(const void *a, const void *b) {
+	const struct interval *left = a, *right = b;
+	return left->start - right->start;
+}
+
+static void
+plan_day(struct day_plan *plan, int32_t day) {
+	uint32_t state = mix(seed ^ mix(day));
+	/* day 0 was a Thursday */
+	bool weekend = (day + 3) % 7 >= 5;
+	uint8_t first_daytime;
+	int16_t start, end, latest;
+	uint32_t i, count;
+
+	memset(plan, 0, sizeof *plan);
+	plan->day = day;
+	plan->planned = true;
+	plan->hr_rest = 52 + draw(&state, 16);
+	plan->bed = -150 + draw(&state, 210);
+	plan->wake = 330 + draw(&state, 180) + (weekend ? 60 : 0);
+
+	add_activity(plan, HealthActivitySleep, plan->bed, plan->wake);
+	start = plan->bed + 20 + draw(&state, 40);
+	while (start + 40 < plan->wake) {
+		/* restful phases, every hour and a half or so */
+		end = start + 20 + draw(&state, 50);
+		if (end > plan->wake - 10) end = plan->wake - 10;
+		add_activity(plan, HealthActivityRestfulSleep, start, end);
+		start = end + 30 + draw(&state, 60);
+	}
+
+	/* charging, right after waking up or before dinner */
+	start = draw(&state, 2) ? plan->wake + 10 + draw(&state, 60)
+	    : 18 * 60 + 30 + draw(&state, 60);
+	add_gap(plan, start, start + 30 + draw(&state, 90));
+	if (draw(&state, 100) < 3) {
+		/* left on the nightstand */
+		start = plan->wake + draw(&state, EVENING - plan->wake);
+		add_gap(plan, start, start + 180 + draw(&state, 420));
+	}
+
+	first_daytime = plan->activity_count;
+	latest = EVENING - 120 - plan->wake - 20;
+	count = 1 + draw(&state, 4);
+	for (i = 0; i < count; i += 1) {
+		start = plan->wake + 20 + draw(&state, latest);
+		add_daytime(plan, first_daytime, HealthActivityWalk,
+		    start, start + 10 + draw(&state, 50));
+	}
+	if (draw(&state, 10) < 3) {
+		start = plan->wake + 20 + draw(&state, latest);
+		add_daytime(plan, first_daytime, HealthActivityRun,
+		    start, start + 20 + draw(&state, 40));
+	}
+	if (draw(&state, 10) == 0) {
+		start = plan->wake + 20 + draw(&state, latest);
+		add_daytime(plan, first_daytime, HealthActivityOpenWorkout,
+		    start, start + 30 + draw(&state, 60));
+	}
+
+	qsort(plan->activity, plan->activity_count, sizeof *plan->activity,
+	    &compare_intervals);
+}
+
+static const struct day_plan *
+get_plan(int32_t day) {
+	struct day_plan *plan = plans + (day & 1);
+	if (!plan->planned || plan->day != day) plan_day(plan, day);
+	return plan;
+}
+
+/* activity_at - the most specific activity of the plan at minute m */
+static HealthActivity
+activity_at(const struct day_plan *plan, int16_t m) {
+	HealthActivity result = HealthActivityNone;
+
+	for (uint8_t i = 0; i < plan->activity_count; i += 1) {
+		const struct interval *interval = plan->activity + i;
+		if (m < interval->start || m >= interval->end) continue;
+		if (result != HealthActivityRestfulSleep)
+			result = interval->activity;
+	}
+	return result;
+}
+
+static AmbientLightLevel
+ambient_light(int16_t m, uint32_t noise, bool outdoors) {
+	if (m >= 7 * 60 && m < 19 * 60)
+		return (outdoors && noise % 5 == 0)
+		    ? AmbientLightLevelVeryLight : AmbientLightLevelLight;
+	if (m >= 19 * 60 && m < 23 * 60) return AmbientLightLevelDark;
+	return AmbientLightLevelVeryDark;
+}
+
+static void
+synthetic_minute(HealthMinuteData *data, time_t t) {
+	int32_t day = t / 86400;
+	int16_t m = (t % 86400) / 60;
+	const struct day_plan *plan = get_plan(day);
+	uint32_t noise = mix(seed ^ (uint32_t)(t / 60) * 2654435761u);
+	uint32_t n = noise >> 8;
+	uint8_t rest = plan->hr_rest;
+	HealthActivity activity;
+	uint32_t heart_rate;
+
+	memset(data, 0, sizeof *data);
+	if (overlaps(plan->gap, plan->gap_count, m, m + 1)
+	    || noise % 211 == 0) {
+		data->is_invalid = true;
+		return;
+	}
+
+	activity = activity_at(plan, m);
+	if (activity == HealthActivityNone) {
+		const struct day_plan *next = get_plan(day + 1);
+		activity = activity_at(next, m - DAY_MINUTES);
+		rest = next->hr_rest;
+	}
+
+	switch (activity) {
+	    case HealthActivitySleep:
+	    case HealthActivityRestfulSleep:
+		data->light = AmbientLightLevelVeryDark;
+		heart_rate = rest - (activity == HealthActivitySleep ? 5 : 9)
+		    + n % 5;
+		if (activity == HealthActivitySleep && noise % 7 == 0) {
+			/* turning over */
+			data->vmc = 100 + n % 300;
+			data->orientation = n >> 12;
+		} else {
+			data->vmc = n % (activity == HealthActivitySleep
+			    ? 80 : 20);
+			data->orientation = mix(seed ^ (uint32_t)(t / 1200));
+		}
+		break;
+	    case HealthActivityWalk:
+		data->steps = 85 + n % 35;
+		data->vmc = 2500 + n % 2000;
+		data->orientation = n >> 12;
+		data->light = ambient_light(m, noise, true);
+		heart_rate = rest + 35 + n % 15;
+		break;
+	    case HealthActivityRun:
+		data->steps = 150 + n % 30;
+		data->vmc = 7000 + n % 4000;
+		data->orientation = n >> 12;
+		data->light = ambient_light(m, noise, true);
+		heart_rate = rest + 80 + n % 25;
+		break;
+	    case HealthActivityOpenWorkout:
+		data->steps = n % 60;
+		data->vmc = 4000 + n % 4000;
+		data->orientation = n >> 12;
+		data->light = ambient_light(m, noise, false);
+		heart_rate = rest + 55 + n % 30;
+		break;
+	    default:
+		data->steps = (noise % 10 < 3) ? n % 40 : 0;
+		data->vmc = 150 + n % 1200 + 25 * data->steps;
+		data->orientation = (noise % 10 == 0) ? n >> 12
+		    : mix(seed ^ (uint32_t)(t / 900));
+		data->light = ambient_light(m, noise, false);
+		heart_rate = rest + 8 + n % 15;
+		/* no reading now and then */
+		if (noise % 25 == 0) heart_rate = 0;
+		break;
+	}
+	data->heart_rate_bpm = heart_rate > 220 ? 220 : heart_rate;
+}
+
+static void
+synthetic_activities(HealthActivityMask activity_mask, time_t time_start,
+    time_t time_end, HealthActivityIteratorCB callback, void *context) {
+	for (int32_t day = time_start / 86400 - 1;
+	    day <= time_end / 86400 + 1;
+	    day += 1) {
+		const struct day_plan *plan = get_plan(day);
+		time_t midnight = (time_t)day * 86400;
+
+		for (uint8_t i = 0; i < plan->activity_count; i += 1) {
+			const struct interval *interval = plan->activity + i;
+			time_t start = midnight + 60 * interval->start;
+			time_t end = midnight + 60 * interval->end;
+			if (!(interval->activity & activity_mask)
+			    || end <= time_start || start >= time_end)
+				continue;
+			if (!callback(interval->activity, start, end, context))
+				return;
+		}
+	}
+}
+
+/* trace replay */
+
+/* parse_line - fill data and mask from a CSV line of minute_data_image */
+static bool
+parse_line(const char *line, HealthMinuteData *data, uint8_t *mask) {
+	long field[7];
+	bool empty[7];
+	const char *p = strchr(line, ',');
+	char *end;
+
+	memset(data, 0, sizeof *data);
+	for (int i = 0; i < 7; i += 1) {
+		if (!p || *p != ',') return false;
+		p += 1;
+		field[i] = strtol(p, &end, 10);
+		empty[i] = (end == p);
+		p = end;
+	}
+
+	*mask = field[5];
+	if (empty[0]) {
+		data->is_invalid = true;
+		return true;
+	}
+	data->steps = field[0];
+	data->orientation = (field[1] & 0xF) | (field[2] << 4);
+	data->vmc = field[3];
+	data->light = field[4];
+	data->heart_rate_bpm = field[6];
+	return true;
+}
+
+static int
+compare_trace_intervals(const void *a, const void *b) {
+	const struct trace_interval *left = a, *right = b;
+	if (left->first_key != right->first_key)
+		return left->first_key < right->first_key ? -1 : 1;
+	return left->activity - right->activity;
+}
+
+/* index_activities - turn the runs of each activity bit into intervals */
+static void
+index_activities(void) {
+	uint32_t capacity = 64;
+
+	trace.intervals = malloc(capacity * sizeof *trace.intervals);
+	trace.interval_count = 0;
+	for (int bit = 0; bit < ACTIVITY_BITS; bit += 1) {
+		uint32_t i = 0;
+		while (i < trace.count) {
+			uint32_t first;
+			if (!(trace.masks[i] & (1 << bit))) {
+				i += 1;
+				continue;
+			}
+			for (first = i; i < trace.count
+			    && (trace.masks[i] & (1 << bit)); i += 1);
+			if (trace.interval_count >= capacity) {
+				capacity *= 2;
+				trace.intervals = realloc(trace.intervals,
+				    capacity * sizeof *trace.intervals);
+			}
+			trace.intervals[trace.interval_count++] =
+			    (struct trace_interval) { 1 << bit,
+			    trace.first_key + first, trace.first_key + i };
+		}
+	}
+	qsort(trace.intervals, trace.interval_count, sizeof *trace.intervals,
+	    &compare_trace_intervals);
+}
+
+bool
+health_data_load_trace(const char *path) {
+	FILE *f = fopen(path, "r");
+	char *line = 0;
+	size_t line_size = 0;
+	uint32_t capacity = 0;
+	unsigned long number = 1;
+
+	if (!f) {
+		perror(path);
+		return false;
+	}
+	if (getline(&line, &line_size, f) < 0
+	    || strncmp(line, TRACE_HEADER, strlen(TRACE_HEADER))) {
+		fprintf(stderr, "%s: not a trace\n", path);
+		fclose(f);
+		return false;
+	}
+
+	trace.count = 0;
+	while (getline(&line, &line_size, f) >= 0) {
+		char *text;
+		long key;
+
+		number += 1;
+		if (line[0] == '#' || line[0] == '\n') continue;
+		key = strtol(line, &text, 10);
+		if (*text != ';' || (trace.count
+		    && key < trace.first_key + (long)trace.count)) {
+			fprintf(stderr, "%s:%lu: bad record\n", path, number);
+			goto fail;
+		}
+		if (!trace.count) trace.first_key = key;
+
+		/* a minute missing from the trace is an invalid one */
+		while (trace.first_key + (long)trace.count <= key) {
+			if (trace.count >= capacity) {
+				capacity = capacity ? capacity * 2 : 4096;
+				trace.minutes = realloc(trace.minutes,
+				    capacity * sizeof *trace.minutes);
+				trace.masks = realloc(trace.masks, capacity);
+			}
+			memset(trace.minutes + trace.count, 0,
+			    sizeof *trace.minutes);
+			trace.minutes[trace.count].is_invalid = true;
+			trace.masks[trace.count] = 0;
+			trace.count += 1;
+		}
+		if (!parse_line(text + 1, trace.minutes + trace.count - 1,
+		    trace.masks + trace.count - 1)) {
+			fprintf(stderr, "%s:%lu: bad line\n", path, number);
+			goto fail;
+		}
+	}
+	free(line);
+	fclose(f);
+
+	if (!trace.count) {
+		fprintf(stderr, "%s: empty trace\n", path);
+		return false;
+	}
+	index_activities();
+	trace.loaded = true;
+	return true;
+
+    fail:
+	free(line);
+	fclose(f);
+	return false;
+}
+
+bool
+health_data_trace_span(int32_t *first_key, int32_t *last_key) {
+	if (!trace.loaded) return false;
+	*first_key = trace.first_key;
+	*last_key = trace.first_key + trace.count - 1;
+	return true;
+}
+
+/* health_data_clip - restrict a time range to the available history */
+void
+health_data_clip(time_t *start, time_t *end) {
+	time_t first, last;
+
+	if (!trace.loaded) return;
+	first = (time_t)trace.first_key * 60;
+	last = first + 60 * (time_t)trace.count;
+	if (*start < first) *start = first;
+	if (*end > last) *end = last;
+}
+
+void
+health_data_minute(HealthMinuteData *data, time_t t) {
+	int64_t index = t / 60 - trace.first_key;
+
+	if (!trace.loaded) {
+		synthetic_minute(data, t);
+	} else if (index >= 0 && index < trace.count) {
+		*data = trace.minutes[index];
+	} else {
+		memset(data, 0, sizeof *data);
+		data->is_invalid = true;
+	}
+}
+
+void
+health_data_activities(HealthActivityMask activity_mask,
+    time_t time_start, time_t time_end,
+    HealthActivityIteratorCB callback, void *context) {
+	if (!trace.loaded) {
+		synthetic_activities(activity_mask, time_start, time_end,
+		    callback, context);
+		return;
+	}
+
+	for (uint32_t i = 0; i < trace.interval_count; i += 1) {
+		const struct trace_interval *interval = trace.intervals + i;
+		time_t start = (time_t)interval->first_key * 60;
+		time_t end = (time_t)interval->end_key * 60;
+		if (start >= time_end) break;
+		if (!(interval->activity & activity_mask) || end <= time_start)
+			continue;
+		if (!callback(interval->activity, start, end, context))
+			return;
+	}
+}
+
+/* capture of the dataLine stream */
+
+void
+health_data_capture(FILE *out) {
+	capture = out;
+	if (capture) fprintf(capture, "%s\n", TRACE_HEADER);
+}
+
+/* health_data_capture_lines - record newline-separated lines of */
+/*    consecutive minutes from first_key */
+void
+health_data_capture_lines(int32_t first_key, const char *lines) {
+	const char *p = lines;
+
+	if (!capture) return;
+	while (*p) {
+		size_t length = strcspn(p, "\n");
+		fprintf(capture, "%" PRIi32 ";%.*s\n", first_key++,
+		    (int)length, p);
+		p += length;
+		if (*p) p += 1;
+	}
+}
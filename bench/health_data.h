@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <pebble.h>
+
+/*
+ * Health history served by the stub: synthetic days planned from a seed,
+ * or the minutes of a trace file.
+ *
+ * A trace starts with TRACE_HEADER, followed by one "key;line" record
+ * per minute, where key is the minute since the epoch and line is the
+ * CSV line the watch sends as dataLine for it. Lines starting with '#'
+ * are comments. This is also the format of the records queued by the
+ * phone, so a capture of the dataLine stream can be replayed as is.
+ */
+
+#define TRACE_HEADER "# pebble-health-export trace v1"
+
+void
+health_data_set_seed(uint32_t seed);
+
+bool
+health_data_load_trace(const char *path);
+
+bool
+health_data_trace_span(int32_t *first_key, int32_t *last_key);
+
+void
+health_data_clip(time_t *start, time_t *end);
+
+void
+health_data_minute(HealthMinuteData *data, time_t t);
+
+void
+health_data_activities(HealthActivityMask activity_mask,
+    time_t time_start, time_t time_end,
+    HealthActivityIteratorCB callback, void *context);
+
+void
+health_data_capture(FILE *out);
+
+void
+health_data_capture_lines(int32_t first_key, const char *lines);
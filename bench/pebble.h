@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Host stand-in for the subset of the Pebble SDK used by the watch sources,
+ * so that they can be built and measured on a development machine.
+ * The implementation lives in pebble_stub.c, and the stub_* functions at
+ * the end are the hooks used by the benchmark driver.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* the watch clock is simulated, see stub_set_now */
+time_t pebble_time(time_t *tloc);
+#define time(tloc) pebble_time(tloc)
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+/* logging */
+
+#define APP_LOG_LEVEL_ERROR	1
+#define APP_LOG_LEVEL_WARNING	50
+#define APP_LOG_LEVEL_INFO	100
+#define APP_LOG_LEVEL_DEBUG	200
+
+void app_log(uint8_t level, const char *filename, int line,
+    const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+#define APP_LOG(level, ...) app_log(level, __FILE__, __LINE__, __VA_ARGS__)
+
+/* message keys, normally generated from package.json */
+
+enum {
+	MESSAGE_KEY_lastSent = 10000,
+	MESSAGE_KEY_modalMessage,
+	MESSAGE_KEY_uploadDone,
+	MESSAGE_KEY_uploadStart,
+	MESSAGE_KEY_uploadFailed,
+	MESSAGE_KEY_cfgStart,
+	MESSAGE_KEY_cfgEnd,
+	MESSAGE_KEY_cfgAutoClose,
+	MESSAGE_KEY_cfgWakeupTime,
+	MESSAGE_KEY_cfgEndpoint,
+	MESSAGE_KEY_cfgAuthToken,
+	MESSAGE_KEY_dataKey,
+	MESSAGE_KEY_dataLine,
+	MESSAGE_KEY_cfgBundleMax,
+	MESSAGE_KEY_resend,
+	MESSAGE_KEY_cfgCsvLines,
+	MESSAGE_KEY_dataBinary,
+	MESSAGE_KEY_cfgUploadWindow,
+	MESSAGE_KEY_cfgFlushDelay,
+	MESSAGE_KEY_cfgUploadFormat,
+	MESSAGE_KEY_cfgEndpointRuns,
+	MESSAGE_KEY_cfgStatsEndpoint,
+	MESSAGE_KEY_cfgFrameBudget,
+	MESSAGE_KEY_cfgResolution,
+	MESSAGE_KEY_cfgBackgroundCollect,
+	MESSAGE_KEY_uploadFirst,
+	MESSAGE_KEY_cfgExportOrder,
+	MESSAGE_KEY_cfgUploadCompression,
+	MESSAGE_KEY_cfgHighWaterEndpoint,
+	MESSAGE_KEY_cfgRetryBudget,
+};
+
+/* graphics */
+
+typedef struct GPoint {
+	int16_t x;
+	int16_t y;
+} GPoint;
+
+typedef struct GSize {
+	int16_t w;
+	int16_t h;
+} GSize;
+
+typedef struct GRect {
+	GPoint origin;
+	GSize size;
+} GRect;
+
+#define GRect(x, y, w, h) ((GRect){ { (x), (y) }, { (w), (h) } })
+
+typedef union GColor8 {
+	uint8_t argb;
+} GColor8, GColor;
+
+#define GColorBlack	((GColor8){ .argb = 0xC0 })
+#define GColorWhite	((GColor8){ .argb = 0xFF })
+#define GColorLightGray	((GColor8){ .argb = 0xEA })
+
+typedef enum {
+	GCornerNone = 0,
+	GCornersAll = 0x0F,
+} GCornerMask;
+
+typedef enum {
+	GTextAlignmentLeft,
+	GTextAlignmentCenter,
+	GTextAlignmentRight,
+} GTextAlignment;
+
+typedef struct GContext GContext;
+typedef struct GFont *GFont;
+
+#define FONT_KEY_GOTHIC_14 "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+
+GFont fonts_get_system_font(const char *font_key);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius,
+    GCornerMask corner_mask);
+void graphics_draw_rect(GContext *ctx, GRect rect);
+
+/* layers and windows */
+
+typedef struct Layer Layer;
+typedef struct TextLayer TextLayer;
+typedef struct Window Window;
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+typedef void (*WindowHandler)(Window *window);
+
+typedef struct WindowHandlers {
+	WindowHandler load;
+	WindowHandler appear;
+	WindowHandler disappear;
+	WindowHandler unload;
+} WindowHandlers;
+
+Layer *layer_create(GRect frame);
+Layer *layer_create_with_data(GRect frame, size_t data_size);
+void layer_destroy(Layer *layer);
+void *layer_get_data(const Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_mark_dirty(Layer *layer);
+void layer_set_hidden(Layer *layer, bool hidden);
+void layer_add_child(Layer *parent, Layer *child);
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+void text_layer_set_text_alignment(TextLayer *text_layer,
+    GTextAlignment text_alignment);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+
+Window *window_create(void);
+void window_destroy(Window *window);
+Layer *window_get_root_layer(const Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_stack_push(Window *window, bool animated);
+void window_stack_pop_all(bool animated);
+
+/* buttons, the handlers are recorded but never called */
+
+typedef enum {
+	BUTTON_ID_BACK = 0,
+	BUTTON_ID_UP,
+	BUTTON_ID_SELECT,
+	BUTTON_ID_DOWN,
+	NUM_BUTTONS
+} ButtonId;
+
+typedef void *ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void *context);
+typedef void (*ClickConfigProvider)(void *context);
+
+void window_set_click_config_provider(Window *window,
+    ClickConfigProvider click_config_provider);
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+
+/* event services */
+
+typedef enum {
+	SECOND_UNIT = 1 << 0,
+	MINUTE_UNIT = 1 << 1,
+	HOUR_UNIT = 1 << 2,
+	DAY_UNIT = 1 << 3,
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback,
+    void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+typedef enum {
+	APP_LAUNCH_SYSTEM,
+	APP_LAUNCH_USER,
+	APP_LAUNCH_PHONE,
+	APP_LAUNCH_WAKEUP,
+} AppLaunchReason;
+
+typedef int32_t WakeupId;
+
+AppLaunchReason launch_reason(void);
+WakeupId wakeup_schedule(time_t timestamp, int32_t cookie,
+    bool notify_if_missed);
+void wakeup_cancel_all(void);
+void app_event_loop(void);
+
+/* connection */
+
+typedef void (*ConnectionHandler)(bool connected);
+
+typedef struct {
+	ConnectionHandler pebble_app_connection_handler;
+	ConnectionHandler pebblekit_connection_handler;
+} ConnectionHandlers;
+
+void connection_service_subscribe(ConnectionHandlers conn_handlers);
+void connection_service_unsubscribe(void);
+bool connection_service_peek_pebble_app_connection(void);
+
+/* background worker */
+
+typedef enum {
+	APP_WORKER_RESULT_SUCCESS = 0,
+	APP_WORKER_RESULT_NO_WORKER = 1,
+	APP_WORKER_RESULT_DIFFERENT_APP = 2,
+	APP_WORKER_RESULT_NOT_RUNNING = 3,
+	APP_WORKER_RESULT_ALREADY_RUNNING = 4,
+	APP_WORKER_RESULT_ASKING_CONFIRMATION = 5,
+} AppWorkerResult;
+
+typedef struct {
+	uint16_t data0;
+	uint16_t data1;
+	uint16_t data2;
+} AppWorkerMessage;
+
+typedef void (*AppWorkerMessageHandler)(uint16_t type,
+    AppWorkerMessage *data);
+
+bool app_worker_is_running(void);
+AppWorkerResult app_worker_launch(void);
+AppWorkerResult app_worker_kill(void);
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler);
+bool app_worker_message_unsubscribe(void);
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data);
+
+/* persistent storage */
+
+#define PERSIST_DATA_MAX_LENGTH 256
+#define PERSIST_STRING_MAX_LENGTH PERSIST_DATA_MAX_LENGTH
+
+bool persist_exists(uint32_t key);
+int persist_get_size(uint32_t key);
+bool persist_read_bool(uint32_t key);
+int32_t persist_read_int(uint32_t key);
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size);
+int persist_read_string(uint32_t key, char *buffer, size_t buffer_size);
+int persist_write_bool(uint32_t key, bool value);
+int persist_write_int(uint32_t key, int32_t value);
+int persist_write_data(uint32_t key, const void *data, size_t size);
+int persist_write_string(uint32_t key, const char *cstring);
+int persist_delete(uint32_t key);
+
+/* dictionaries */
+
+typedef enum {
+	TUPLE_BYTE_ARRAY = 0,
+	TUPLE_CSTRING = 1,
+	TUPLE_UINT = 2,
+	TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+	uint32_t key;
+	TupleType type:8;
+	uint16_t length;
+	union {
+		uint8_t data[0];
+		char cstring[0];
+		uint8_t uint8;
+		uint16_t uint16;
+		uint32_t uint32;
+		int8_t int8;
+		int16_t int16;
+		int32_t int32;
+	} value[];
+} Tuple;
+
+typedef struct {
+	uint8_t *begin;
+	uint8_t *end;
+	uint8_t *cursor;
+	uint8_t *limit;
+} DictionaryIterator;
+
+typedef enum {
+	DICT_OK = 0,
+	DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+	DICT_INVALID_ARGS = 1 << 2,
+} DictionaryResult;
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...);
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *buffer,
+    uint16_t size);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key,
+    const uint8_t *data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator *iter,
+    const uint32_t key, const char *cstring);
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key,
+    const void *integer, const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter,
+    const uint32_t key, const uint8_t value);
+uint32_t dict_write_end(DictionaryIterator *iter);
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter,
+    const uint8_t *buffer, uint16_t size);
+Tuple *dict_read_first(DictionaryIterator *iter);
+Tuple *dict_read_next(DictionaryIterator *iter);
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+
+/* app messages */
+
+typedef enum {
+	APP_MSG_OK = 0,
+	APP_MSG_SEND_TIMEOUT = 1 << 1,
+	APP_MSG_SEND_REJECTED = 1 << 2,
+	APP_MSG_NOT_CONNECTED = 1 << 3,
+	APP_MSG_APP_NOT_RUNNING = 1 << 4,
+	APP_MSG_INVALID_ARGS = 1 << 5,
+	APP_MSG_BUSY = 1 << 6,
+	APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+	APP_MSG_ALREADY_RELEASED = 1 << 9,
+	APP_MSG_CALLBACK_ALREADY_REGISTERED = 1 << 10,
+	APP_MSG_CALLBACK_NOT_REGISTERED = 1 << 11,
+	APP_MSG_OUT_OF_MEMORY = 1 << 12,
+	APP_MSG_CLOSED = 1 << 13,
+	APP_MSG_INTERNAL_ERROR = 1 << 14,
+	APP_MSG_INVALID_STATE = 1 << 15,
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator,
+    void *context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator *iterator,
+    void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator,
+    AppMessageResult reason, void *context);
+
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+AppMessageResult app_message_open(const uint32_t size_inbound,
+    const uint32_t size_outbound);
+AppMessageInboxReceived app_message_register_inbox_received(
+    AppMessageInboxReceived received_callback);
+AppMessageOutboxSent app_message_register_outbox_sent(
+    AppMessageOutboxSent sent_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(
+    AppMessageOutboxFailed failed_callback);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+/* health */
+
+typedef enum {
+	AmbientLightLevelUnknown = 0,
+	AmbientLightLevelVeryDark,
+	AmbientLightLevelDark,
+	AmbientLightLevelLight,
+	AmbientLightLevelVeryLight,
+} AmbientLightLevel;
+
+typedef struct {
+	uint8_t steps;
+	uint8_t orientation;
+	uint16_t vmc;
+	bool is_invalid:1;
+	AmbientLightLevel light:3;
+	uint8_t padding:4;
+	uint8_t heart_rate_bpm;
+	uint8_t reserved[6];
+} HealthMinuteData;
+
+typedef enum {
+	HealthActivityNone = 0,
+	HealthActivitySleep = 1 << 0,
+	HealthActivityRestfulSleep = 1 << 1,
+	HealthActivityWalk = 1 << 2,
+	HealthActivityRun = 1 << 3,
+	HealthActivityOpenWorkout = 1 << 4,
+} HealthActivity;
+
+typedef uint32_t HealthActivityMask;
+#define HealthActivityMaskAll ((HealthActivityOpenWorkout << 1) - 1)
+
+typedef enum {
+	HealthIterationDirectionPast,
+	HealthIterationDirectionFuture,
+} HealthIterationDirection;
+
+typedef enum {
+	HealthServiceAccessibilityMaskAvailable = 1 << 0,
+	HealthServiceAccessibilityMaskNoPermission = 1 << 1,
+	HealthServiceAccessibilityMaskNotSupported = 1 << 2,
+	HealthServiceAccessibilityMaskNotAvailable = 1 << 3,
+} HealthServiceAccessibilityMask;
+
+typedef bool (*HealthActivityIteratorCB)(HealthActivity activity,
+    time_t time_start, time_t time_end, void *context);
+
+uint32_t health_service_get_minute_history(HealthMinuteData *minute_data,
+    uint32_t max_records, time_t *time_start, time_t *time_end);
+HealthServiceAccessibilityMask health_service_any_activity_accessible(
+    HealthActivityMask activity_mask, time_t time_start, time_t time_end);
+void health_service_activities_iterate(HealthActivityMask activity_mask,
+    time_t time_start, time_t time_end, HealthIterationDirection direction,
+    HealthActivityIteratorCB callback, void *context);
+
+/* benchmark hooks */
+
+struct stub_stats {
+	uint32_t	history_calls;
+	uint32_t	history_minutes;
+	uint32_t	activity_calls;
+	uint32_t	messages_sent;
+	uint64_t	bytes_sent;
+	uint32_t	output_hash;
+};
+
+extern struct stub_stats stub_stats;
+
+void stub_set_now(time_t now);
+void stub_set_log_level(uint8_t level);
+bool stub_outbox_pending(void);
+bool stub_run_timers(void);
+bool stub_outbox_deliver(void);
+void stub_set_connected(bool connected);
+void stub_set_loss(unsigned permille);
+void stub_capture_binary(FILE *out);
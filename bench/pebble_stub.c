@@ -0,0 +1,820 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdarg.h>
+
+#include <pebble.h>
+
+#include "health_data.h"
+
+#undef time
+
+struct stub_stats stub_stats;
+
+static time_t stub_now = 0;
+static uint8_t stub_log_level = APP_LOG_LEVEL_ERROR;
+
+void
+stub_set_now(time_t now) {
+	stub_now = now;
+}
+
+void
+stub_set_log_level(uint8_t level) {
+	stub_log_level = level;
+}
+
+time_t
+pebble_time(time_t *tloc) {
+	time_t now = stub_now ? stub_now : time(0);
+	if (tloc) *tloc = now;
+	return now;
+}
+
+void
+app_log(uint8_t level, const char *filename, int line, const char *fmt, ...) {
+	va_list ap;
+
+	if (level > stub_log_level) return;
+	fprintf(stderr, "%s:%d: ", filename, line);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+}
+
+/* graphics, layers and windows: only what is needed to keep state around */
+
+struct Layer {
+	GRect		frame;
+	bool		hidden;
+	LayerUpdateProc	update_proc;
+	void		*data;
+};
+
+struct TextLayer {
+	Layer		layer;
+	const char	*text;
+};
+
+struct Window {
+	Layer		root;
+	WindowHandlers	handlers;
+};
+
+static Window *top_window = 0;
+
+GFont
+fonts_get_system_font(const char *font_key) {
+	(void)font_key;
+	return 0;
+}
+
+void
+graphics_context_set_fill_color(GContext *ctx, GColor color) {
+	(void)ctx;
+	(void)color;
+}
+
+void
+graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+	(void)ctx;
+	(void)color;
+}
+
+void
+graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius,
+    GCornerMask corner_mask) {
+	(void)ctx;
+	(void)rect;
+	(void)corner_radius;
+	(void)corner_mask;
+}
+
+void
+graphics_draw_rect(GContext *ctx, GRect rect) {
+	(void)ctx;
+	(void)rect;
+}
+
+Layer *
+layer_create(GRect frame) {
+	return layer_create_with_data(frame, 0);
+}
+
+Layer *
+layer_create_with_data(GRect frame, size_t data_size) {
+	Layer *layer = calloc(1, sizeof *layer);
+	layer->frame = frame;
+	layer->data = data_size ? calloc(1, data_size) : 0;
+	return layer;
+}
+
+void
+layer_destroy(Layer *layer) {
+	if (!layer) return;
+	free(layer->data);
+	free(layer);
+}
+
+void *
+layer_get_data(const Layer *layer) {
+	return layer->data;
+}
+
+GRect
+layer_get_bounds(const Layer *layer) {
+	return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+void
+layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+	layer->update_proc = update_proc;
+}
+
+void
+layer_mark_dirty(Layer *layer) {
+	(void)layer;
+}
+
+void
+layer_set_hidden(Layer *layer, bool hidden) {
+	layer->hidden = hidden;
+}
+
+void
+layer_add_child(Layer *parent, Layer *child) {
+	(void)parent;
+	(void)child;
+}
+
+TextLayer *
+text_layer_create(GRect frame) {
+	TextLayer *text_layer = calloc(1, sizeof *text_layer);
+	text_layer->layer.frame = frame;
+	return text_layer;
+}
+
+void
+text_layer_destroy(TextLayer *text_layer) {
+	free(text_layer);
+}
+
+Layer *
+text_layer_get_layer(TextLayer *text_layer) {
+	return &text_layer->layer;
+}
+
+void
+text_layer_set_text(TextLayer *text_layer, const char *text) {
+	text_layer->text = text;
+}
+
+void
+text_layer_set_text_alignment(TextLayer *text_layer,
+    GTextAlignment text_alignment) {
+	(void)text_layer;
+	(void)text_alignment;
+}
+
+void
+text_layer_set_font(TextLayer *text_layer, GFont font) {
+	(void)text_layer;
+	(void)font;
+}
+
+Window *
+window_create(void) {
+	Window *window = calloc(1, sizeof *window);
+	window->root.frame = GRect(0, 0, 144, 168);
+	return window;
+}
+
+void
+window_destroy(Window *window) {
+	free(window);
+}
+
+Layer *
+window_get_root_layer(const Window *window) {
+	return (Layer *)&window->root;
+}
+
+void
+window_set_window_handlers(Window *window, WindowHandlers handlers) {
+	window->handlers = handlers;
+}
+
+void
+window_set_click_config_provider(Window *window,
+    ClickConfigProvider click_config_provider) {
+	(void)window;
+	if (click_config_provider) click_config_provider(0);
+}
+
+void
+window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+	(void)button_id;
+	(void)handler;
+}
+
+void
+window_stack_push(Window *window, bool animated) {
+	(void)animated;
+	top_window = window;
+	if (window->handlers.load) window->handlers.load(window);
+}
+
+void
+window_stack_pop_all(bool animated) {
+	(void)animated;
+	if (top_window && top_window->handlers.unload)
+		top_window->handlers.unload(top_window);
+	top_window = 0;
+}
+
+/* event services */
+
+void
+tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+	(void)tick_units;
+	(void)handler;
+}
+
+void
+tick_timer_service_unsubscribe(void) {
+}
+
+/* background worker: never running, messages are dropped */
+
+bool
+app_worker_is_running(void) {
+	return false;
+}
+
+AppWorkerResult
+app_worker_launch(void) {
+	return APP_WORKER_RESULT_SUCCESS;
+}
+
+AppWorkerResult
+app_worker_kill(void) {
+	return APP_WORKER_RESULT_NOT_RUNNING;
+}
+
+bool
+app_worker_message_subscribe(AppWorkerMessageHandler handler) {
+	(void)handler;
+	return true;
+}
+
+bool
+app_worker_message_unsubscribe(void) {
+	return true;
+}
+
+void
+app_worker_send_message(uint8_t type, AppWorkerMessage *data) {
+	(void)type;
+	(void)data;
+}
+
+void
+worker_event_loop(void) {
+}
+
+/* timers: no real clock, stub_run_timers fires them in deadline order */
+
+#define TIMER_SLOTS 16
+
+struct AppTimer {
+	bool			used;
+	uint64_t		deadline;
+	AppTimerCallback	callback;
+	void			*data;
+};
+
+static AppTimer timers[TIMER_SLOTS];
+static uint64_t timer_clock = 0;
+
+AppTimer *
+app_timer_register(uint32_t timeout_ms, AppTimerCallback callback,
+    void *callback_data) {
+	for (size_t i = 0; i < TIMER_SLOTS; i += 1) {
+		if (timers[i].used) continue;
+		timers[i].used = true;
+		timers[i].deadline = timer_clock + timeout_ms;
+		timers[i].callback = callback;
+		timers[i].data = callback_data;
+		return timers + i;
+	}
+	fprintf(stderr, "app_timer_register: out of timer slots\n");
+	return 0;
+}
+
+bool
+app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+	if (!timer_handle || !timer_handle->used) return false;
+	timer_handle->deadline = timer_clock + new_timeout_ms;
+	return true;
+}
+
+void
+app_timer_cancel(AppTimer *timer_handle) {
+	if (timer_handle) timer_handle->used = false;
+}
+
+/* stub_run_timers - fire the pending timer with the earliest deadline */
+bool
+stub_run_timers(void) {
+	AppTimer *next = 0;
+
+	for (size_t i = 0; i < TIMER_SLOTS; i += 1) {
+		if (timers[i].used
+		    && (!next || timers[i].deadline < next->deadline))
+			next = timers + i;
+	}
+
+	if (!next) return false;
+	next->used = false;
+	if (next->deadline > timer_clock) timer_clock = next->deadline;
+	next->callback(next->data);
+	return true;
+}
+
+uint16_t
+time_ms(time_t *tloc, uint16_t *out_ms) {
+	struct timespec ts;
+	uint16_t ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ms = ts.tv_nsec / 1000000;
+	if (tloc) *tloc = ts.tv_sec;
+	if (out_ms) *out_ms = ms;
+	return ms;
+}
+
+AppLaunchReason
+launch_reason(void) {
+	return APP_LAUNCH_USER;
+}
+
+WakeupId
+wakeup_schedule(time_t timestamp, int32_t cookie, bool notify_if_missed) {
+	(void)timestamp;
+	(void)cookie;
+	(void)notify_if_missed;
+	return 1;
+}
+
+void
+wakeup_cancel_all(void) {
+}
+
+void
+app_event_loop(void) {
+}
+
+/* persistent storage, kept in memory */
+
+#define PERSIST_SLOTS 256
+
+static struct persist_slot {
+	bool		used;
+	uint32_t	key;
+	int		size;
+	uint8_t		data[PERSIST_DATA_MAX_LENGTH];
+} persist_slots[PERSIST_SLOTS];
+
+static struct persist_slot *
+persist_find(uint32_t key, bool create) {
+	struct persist_slot *free_slot = 0;
+
+	for (size_t i = 0; i < PERSIST_SLOTS; i += 1) {
+		if (persist_slots[i].used && persist_slots[i].key == key)
+			return persist_slots + i;
+		if (!persist_slots[i].used && !free_slot)
+			free_slot = persist_slots + i;
+	}
+
+	if (!create || !free_slot) return 0;
+	free_slot->used = true;
+	free_slot->key = key;
+	free_slot->size = 0;
+	return free_slot;
+}
+
+bool
+persist_exists(uint32_t key) {
+	return persist_find(key, false) != 0;
+}
+
+int
+persist_get_size(uint32_t key) {
+	struct persist_slot *slot = persist_find(key, false);
+	return slot ? slot->size : -1;
+}
+
+int
+persist_read_data(uint32_t key, void *buffer, size_t buffer_size) {
+	struct persist_slot *slot = persist_find(key, false);
+	if (!slot) return -1;
+	if (buffer_size > (size_t)slot->size) buffer_size = slot->size;
+	memcpy(buffer, slot->data, buffer_size);
+	return buffer_size;
+}
+
+int
+persist_write_data(uint32_t key, const void *data, size_t size) {
+	struct persist_slot *slot = persist_find(key, true);
+	if (!slot) return -1;
+	if (size > PERSIST_DATA_MAX_LENGTH) size = PERSIST_DATA_MAX_LENGTH;
+	memcpy(slot->data, data, size);
+	slot->size = size;
+	return size;
+}
+
+bool
+persist_read_bool(uint32_t key) {
+	bool value = false;
+	persist_read_data(key, &value, sizeof value);
+	return value;
+}
+
+int32_t
+persist_read_int(uint32_t key) {
+	int32_t value = 0;
+	persist_read_data(key, &value, sizeof value);
+	return value;
+}
+
+int
+persist_read_string(uint32_t key, char *buffer, size_t buffer_size) {
+	int size = persist_read_data(key, buffer, buffer_size);
+	if (size > 0) buffer[size - 1] = 0;
+	return size;
+}
+
+int
+persist_write_bool(uint32_t key, bool value) {
+	return persist_write_data(key, &value, sizeof value);
+}
+
+int
+persist_write_int(uint32_t key, int32_t value) {
+	return persist_write_data(key, &value, sizeof value);
+}
+
+int
+persist_write_string(uint32_t key, const char *cstring) {
+	return persist_write_data(key, cstring, strlen(cstring) + 1);
+}
+
+int
+persist_delete(uint32_t key) {
+	struct persist_slot *slot = persist_find(key, false);
+	if (!slot) return -1;
+	slot->used = false;
+	return 0;
+}
+
+/* dictionaries, using the same serialization as the firmware */
+
+#define TUPLE_HEADER_SIZE (sizeof(uint32_t) + 1 + sizeof(uint16_t))
+
+uint32_t
+dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+	uint32_t result = 1 + tuple_count * TUPLE_HEADER_SIZE;
+	va_list ap;
+
+	va_start(ap, tuple_count);
+	for (uint8_t i = 0; i < tuple_count; i += 1)
+		result += va_arg(ap, unsigned);
+	va_end(ap);
+	return result;
+}
+
+DictionaryResult
+dict_write_begin(DictionaryIterator *iter, uint8_t *buffer, uint16_t size) {
+	if (!iter || !buffer || size < 1) return DICT_INVALID_ARGS;
+	iter->begin = buffer;
+	iter->limit = buffer + size;
+	iter->cursor = iter->end = buffer + 1;
+	buffer[0] = 0;
+	return DICT_OK;
+}
+
+static DictionaryResult
+dict_write_tuple(DictionaryIterator *iter, uint32_t key, TupleType type,
+    const void *data, uint16_t size) {
+	Tuple *tuple;
+
+	if (!iter || !iter->begin) return DICT_INVALID_ARGS;
+	if (iter->cursor + TUPLE_HEADER_SIZE + size > iter->limit)
+		return DICT_NOT_ENOUGH_STORAGE;
+
+	tuple = (Tuple *)iter->cursor;
+	tuple->key = key;
+	tuple->type = type;
+	tuple->length = size;
+	memcpy(tuple->value, data, size);
+	iter->cursor += TUPLE_HEADER_SIZE + size;
+	iter->end = iter->cursor;
+	iter->begin[0] += 1;
+	return DICT_OK;
+}
+
+DictionaryResult
+dict_write_data(DictionaryIterator *iter, const uint32_t key,
+    const uint8_t *data, const uint16_t size) {
+	return dict_write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult
+dict_write_cstring(DictionaryIterator *iter, const uint32_t key,
+    const char *cstring) {
+	return dict_write_tuple(iter, key, TUPLE_CSTRING,
+	    cstring, strlen(cstring) + 1);
+}
+
+DictionaryResult
+dict_write_int(DictionaryIterator *iter, const uint32_t key,
+    const void *integer, const uint8_t width_bytes, const bool is_signed) {
+	if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4)
+		return DICT_INVALID_ARGS;
+	return dict_write_tuple(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT,
+	    integer, width_bytes);
+}
+
+DictionaryResult
+dict_write_uint8(DictionaryIterator *iter, const uint32_t key,
+    const uint8_t value) {
+	return dict_write_tuple(iter, key, TUPLE_UINT, &value, 1);
+}
+
+uint32_t
+dict_write_end(DictionaryIterator *iter) {
+	return iter->end - iter->begin;
+}
+
+Tuple *
+dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *buffer,
+    uint16_t size) {
+	iter->begin = (uint8_t *)buffer;
+	iter->limit = iter->end = (uint8_t *)buffer + size;
+	return dict_read_first(iter);
+}
+
+Tuple *
+dict_read_first(DictionaryIterator *iter) {
+	iter->cursor = iter->begin + 1;
+	if (!iter->begin[0]) return 0;
+	return (Tuple *)iter->cursor;
+}
+
+Tuple *
+dict_read_next(DictionaryIterator *iter) {
+	Tuple *tuple = (Tuple *)iter->cursor;
+	iter->cursor += TUPLE_HEADER_SIZE + tuple->length;
+	if (iter->cursor >= iter->end) return 0;
+	return (Tuple *)iter->cursor;
+}
+
+Tuple *
+dict_find(const DictionaryIterator *iter, const uint32_t key) {
+	const uint8_t *cursor = iter->begin + 1;
+
+	for (uint8_t i = 0; i < iter->begin[0] && cursor < iter->end; i++) {
+		Tuple *tuple = (Tuple *)cursor;
+		if (tuple->key == key) return tuple;
+		cursor += TUPLE_HEADER_SIZE + tuple->length;
+	}
+	return 0;
+}
+
+/* app messages: a single outbox delivered by stub_outbox_deliver */
+
+#define OUTBOX_SIZE_MAXIMUM 8200
+
+static AppMessageInboxReceived inbox_received = 0;
+static AppMessageOutboxSent outbox_sent = 0;
+static AppMessageOutboxFailed outbox_failed = 0;
+static ConnectionHandlers connection_handlers;
+static bool phone_connected = true;
+static unsigned loss_permille = 0;
+static uint32_t loss_seed = 1;
+static uint8_t *outbox_buffer = 0;
+static uint32_t outbox_size = 0;
+static DictionaryIterator outbox_iter;
+static bool outbox_begun = false;
+static bool outbox_in_flight = false;
+static FILE *binary_capture = 0;
+
+uint32_t
+app_message_inbox_size_maximum(void) {
+	return OUTBOX_SIZE_MAXIMUM;
+}
+
+uint32_t
+app_message_outbox_size_maximum(void) {
+	return OUTBOX_SIZE_MAXIMUM;
+}
+
+AppMessageResult
+app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+	(void)size_inbound;
+	free(outbox_buffer);
+	outbox_buffer = malloc(size_outbound);
+	outbox_size = size_outbound;
+	return outbox_buffer ? APP_MSG_OK : APP_MSG_OUT_OF_MEMORY;
+}
+
+AppMessageInboxReceived
+app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+	AppMessageInboxReceived previous = inbox_received;
+	inbox_received = received_callback;
+	return previous;
+}
+
+AppMessageOutboxSent
+app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+	AppMessageOutboxSent previous = outbox_sent;
+	outbox_sent = sent_callback;
+	return previous;
+}
+
+AppMessageOutboxFailed
+app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+	AppMessageOutboxFailed previous = outbox_failed;
+	outbox_failed = failed_callback;
+	return previous;
+}
+
+/* fnv1a - running FNV-1a hash of the emitted messages */
+static uint32_t
+fnv1a(uint32_t hash, const uint8_t *data, size_t size) {
+	if (!hash) hash = 2166136261u;
+	while (size--) hash = (hash ^ *data++) * 16777619u;
+	return hash;
+}
+
+AppMessageResult
+app_message_outbox_begin(DictionaryIterator **iterator) {
+	if (!outbox_buffer) return APP_MSG_INVALID_STATE;
+	if (outbox_begun || outbox_in_flight) return APP_MSG_BUSY;
+	dict_write_begin(&outbox_iter, outbox_buffer, outbox_size);
+	outbox_begun = true;
+	*iterator = &outbox_iter;
+	return APP_MSG_OK;
+}
+
+AppMessageResult
+app_message_outbox_send(void) {
+	if (!outbox_begun) return APP_MSG_INVALID_STATE;
+	outbox_begun = false;
+	outbox_in_flight = true;
+	stub_stats.messages_sent += 1;
+	stub_stats.bytes_sent += dict_write_end(&outbox_iter);
+	stub_stats.output_hash = fnv1a(stub_stats.output_hash,
+	    outbox_buffer, dict_write_end(&outbox_iter));
+	return APP_MSG_OK;
+}
+
+bool
+stub_outbox_pending(void) {
+	return outbox_in_flight;
+}
+
+/* stub_set_loss - fail that many messages out of 1000, alternately */
+/*    busy and timed out */
+void
+stub_set_loss(unsigned permille) {
+	loss_permille = permille;
+}
+
+/* stub_capture_binary - append the dataBinary blocks delivered to out */
+void
+stub_capture_binary(FILE *out) {
+	binary_capture = out;
+}
+
+/* capture_lines - hand the CSV lines of a delivered message to the */
+/*    trace capture, and its binary block to the binary one */
+static void
+capture_lines(void) {
+	DictionaryIterator iter;
+	Tuple *key, *line, *block;
+
+	dict_read_begin_from_buffer(&iter, outbox_buffer,
+	    dict_write_end(&outbox_iter));
+	key = dict_find(&iter, MESSAGE_KEY_dataKey);
+	line = dict_find(&iter, MESSAGE_KEY_dataLine);
+	if (key && line) health_data_capture_lines(key->value->int32,
+	    line->value->cstring);
+	block = dict_find(&iter, MESSAGE_KEY_dataBinary);
+	if (block && binary_capture)
+		fwrite(block->value->data, 1, block->length, binary_capture);
+}
+
+/* stub_outbox_deliver - acknowledge the message in flight, if any, */
+/*    or fail it while disconnected or when it is lost */
+bool
+stub_outbox_deliver(void) {
+	if (!outbox_in_flight) return false;
+	outbox_in_flight = false;
+	loss_seed = loss_seed * 1103515245 + 12345;
+	if (!phone_connected) {
+		if (outbox_failed)
+			outbox_failed(&outbox_iter, APP_MSG_NOT_CONNECTED, 0);
+	} else if ((loss_seed >> 16) % 1000 < loss_permille) {
+		if (outbox_failed)
+			outbox_failed(&outbox_iter, (loss_seed >> 8) & 1
+			    ? APP_MSG_BUSY : APP_MSG_SEND_TIMEOUT, 0);
+	} else {
+		capture_lines();
+		if (outbox_sent) outbox_sent(&outbox_iter, 0);
+	}
+	return true;
+}
+
+/* connection: up until stub_set_connected says otherwise */
+
+void
+connection_service_subscribe(ConnectionHandlers conn_handlers) {
+	connection_handlers = conn_handlers;
+}
+
+void
+connection_service_unsubscribe(void) {
+	memset(&connection_handlers, 0, sizeof connection_handlers);
+}
+
+bool
+connection_service_peek_pebble_app_connection(void) {
+	return phone_connected;
+}
+
+void
+stub_set_connected(bool connected) {
+	if (connected == phone_connected) return;
+	phone_connected = connected;
+	if (connection_handlers.pebble_app_connection_handler)
+		connection_handlers.pebble_app_connection_handler(connected);
+}
+
+/* health: served by health_data, synthetic or from a trace */
+
+uint32_t
+health_service_get_minute_history(HealthMinuteData *minute_data,
+    uint32_t max_records, time_t *time_start, time_t *time_end) {
+	time_t start = *time_start - *time_start % 60;
+	time_t end = *time_end;
+	time_t now = pebble_time(0);
+	uint32_t count = 0;
+
+	stub_stats.history_calls += 1;
+	if (end > now) end = now;
+	health_data_clip(&start, &end);
+
+	while (count < max_records && start + 60 * (time_t)count < end) {
+		health_data_minute(minute_data + count, start + 60 * count);
+		count += 1;
+	}
+
+	stub_stats.history_minutes += count;
+	*time_start = start;
+	*time_end = start + 60 * count;
+	return count;
+}
+
+HealthServiceAccessibilityMask
+health_service_any_activity_accessible(HealthActivityMask activity_mask,
+    time_t time_start, time_t time_end) {
+	(void)activity_mask;
+	(void)time_start;
+	(void)time_end;
+	return HealthServiceAccessibilityMaskAvailable;
+}
+
+void
+health_service_activities_iterate(HealthActivityMask activity_mask,
+    time_t time_start, time_t time_end, HealthIterationDirection direction,
+    HealthActivityIteratorCB callback, void *context) {
+	(void)direction;
+	stub_stats.activity_calls += 1;
+	health_data_activities(activity_mask, time_start, time_end,
+	    callback, context);
+}
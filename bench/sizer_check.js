@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Check of src/pkjs/batch_sizer.js: a single failure after a run of
+ * successful batches shrinks the size once, and the next full batch
+ * uploaded grows it again.
+ *
+ * Usage: node sizer_check.js
+ */
+
+var path = require("path");
+
+var BatchSizer = require(path.join(__dirname, "..", "src", "pkjs",
+    "batch_sizer.js"));
+
+var failures = 0;
+
+function expect(what, value, expected) {
+   if (value === expected) return;
+   console.log(what + ": " + value + ", expected " + expected);
+   failures++;
+}
+
+/* succeed - upload a full batch, returning the size after it */
+function succeed(sizer, latency_ms) {
+   var count = sizer.current();
+   sizer.success(count, count * 100, latency_ms);
+   return sizer.current();
+}
+
+function checkTransientFailure() {
+   var sizer = new BatchSizer(10000);
+   var before, after;
+
+   for (var i = 0; i < 4; i++) succeed(sizer, 100);
+   before = sizer.current();
+   sizer.failure();
+   expect("size after a failure", sizer.current(), before / 2);
+   after = succeed(sizer, 100);
+   expect("growth after a single failure", after > before / 2, true);
+}
+
+checkTransientFailure();
+console.log(failures ? failures + " checks failed" : "batch sizer ok");
+process.exit(failures ? 1 : 0);
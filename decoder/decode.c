@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Command-line front end of the minute decoder: it decodes files of text
+ * records or of binary blocks, telling them apart from their first bytes,
+ * and reports what they hold, prints their records, checks them against
+ * each other or measures the decoding throughput.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "minute_decoder.h"
+
+struct input {
+	const char	*path;
+	uint8_t		*data;
+	size_t		size;
+	bool		binary;
+};
+
+static double
+elapsed(const struct timespec *start, const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec)
+	    + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void
+usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-b seconds] [-p] [-V] file ...\n"
+	    "  -b seconds  decode each file again for that long, and report\n"
+	    "           the throughput\n"
+	    "  -p       print the records, in the format queued by the phone\n"
+	    "  -V       check that text records print back as they are, and\n"
+	    "           that all the files hold the same minutes\n", name);
+}
+
+/* read_input - load a whole file */
+static bool
+read_input(struct input *input, const char *path) {
+	FILE *f = fopen(path, "rb");
+	size_t capacity = 1 << 20;
+	size_t n;
+
+	if (!f) {
+		perror(path);
+		return false;
+	}
+	input->path = path;
+	input->size = 0;
+	input->data = malloc(capacity);
+	while (input->data && (n = fread(input->data + input->size, 1,
+	    capacity - input->size, f)) > 0) {
+		input->size += n;
+		if (input->size == capacity) {
+			capacity *= 2;
+			input->data = realloc(input->data, capacity);
+		}
+	}
+	fclose(f);
+	if (!input->data) {
+		fprintf(stderr, "%s: out of memory\n", path);
+		return false;
+	}
+	input->binary = minute_is_binary(input->data, input->size);
+	return true;
+}
+
+static bool
+decode(struct minute_table *table, const struct input *input) {
+	struct decode_error error;
+	bool ok;
+
+	minute_table_clear(table);
+	ok = input->binary
+	    ? minute_decode_binary(table, input->data, input->size, &error)
+	    : minute_decode_text(table, (const char *)input->data,
+	    input->size, &error);
+	if (ok) return true;
+
+	if (error.line)
+		fprintf(stderr, "%s:%zu: %s\n", input->path, error.line,
+		    error.message);
+	else
+		fprintf(stderr, "%s: offset %zu: %s\n", input->path,
+		    error.offset, error.message);
+	return false;
+}
+
+/* check_text - compare every record line with its printed record */
+static bool
+check_text(const struct minute_table *table, const struct input *input) {
+	const char *p = (const char *)input->data;
+	const char *end = p + input->size;
+	char record[MINUTE_RECORD_MAX];
+	size_t line = 0, index = 0;
+
+	while (p < end) {
+		const char *eol = memchr(p, '\n', end - p);
+		size_t length, expected;
+		const char *text = record;
+
+		if (!eol) eol = end;
+		length = eol - p;
+		if (length && p[length - 1] == '\r') length -= 1;
+		line += 1;
+		if (length && *p != '#') {
+			expected = minute_format_record(table, index++,
+			    record);
+			/* plain CSV lines come without their key */
+			if (strcspn(p, ",;") < length && p[strcspn(p, ",;")]
+			    == ',') {
+				const char *semicolon = memchr(record, ';',
+				    expected);
+				expected -= semicolon + 1 - record;
+				text = semicolon + 1;
+			}
+			if (length != expected || memcmp(p, text, length)) {
+				fprintf(stderr, "%s:%zu: prints back as %.*s\n",
+				    input->path, line, (int)expected, text);
+				return false;
+			}
+		}
+		p = eol + 1;
+	}
+	return true;
+}
+
+static void
+summary(const struct minute_table *table, const struct input *input) {
+	uint64_t minutes = 0, invalid = 0;
+
+	for (size_t i = 0; i < table->count; i += 1) {
+		minutes += table->span[i];
+		invalid += table->invalid[i];
+	}
+
+	printf("file:           %s (%s, %zu bytes)\n", input->path,
+	    input->binary ? "binary" : "text", input->size);
+	printf("records:        %zu, resolution %u\n", table->count,
+	    (unsigned)table->resolution);
+	printf("minutes:        %" PRIu64 " (%" PRIu64 " invalid)\n",
+	    minutes, invalid);
+	if (table->count)
+		printf("keys:           %" PRIi32 "-%" PRIi32 "\n",
+		    table->key[0], table->key[table->count - 1]
+		    + table->span[table->count - 1] - 1);
+	printf("content hash:   %08" PRIx32 "\n", minute_table_hash(table));
+}
+
+/* benchmark - decode the input again and again for that many seconds */
+static bool
+benchmark(struct minute_table *table, const struct input *input,
+    double seconds) {
+	struct timespec start, now;
+	unsigned rounds = 0;
+	double spent;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		if (!decode(table, input)) return false;
+		rounds += 1;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		spent = elapsed(&start, &now);
+	} while (spent < seconds);
+
+	printf("rounds:         %u in %.3f s\n", rounds, spent);
+	printf("records/sec:    %.0f\n", table->count * rounds / spent);
+	printf("MB/sec:         %.1f\n", input->size * rounds / spent / 1e6);
+	return true;
+}
+
+int
+main(int argc, char **argv) {
+	struct minute_table table;
+	struct input input;
+	char record[MINUTE_RECORD_MAX];
+	double seconds = 0;
+	bool print = false, verify = false;
+	uint32_t first_hash = 0;
+	int status = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:pV")) != -1) {
+		switch (opt) {
+		    case 'b':
+			seconds = strtod(optarg, 0);
+			break;
+		    case 'p':
+			print = true;
+			break;
+		    case 'V':
+			verify = true;
+			break;
+		    default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	minute_table_init(&table);
+	for (int i = optind; i < argc; i += 1) {
+		if (!read_input(&input, argv[i])) return 1;
+		if (!decode(&table, &input)) return 1;
+
+		if (print) {
+			for (size_t r = 0; r < table.count; r += 1) {
+				size_t length = minute_format_record(&table, r,
+				    record);
+				printf("%.*s\n", (int)length, record);
+			}
+		} else {
+			if (i > optind) printf("\n");
+			summary(&table, &input);
+		}
+
+		if (verify) {
+			uint32_t hash = minute_table_hash(&table);
+			if (!input.binary && !check_text(&table, &input))
+				status = 1;
+			if (i == optind) {
+				first_hash = hash;
+			} else if (hash != first_hash) {
+				fprintf(stderr, "%s: other minutes than %s\n",
+				    argv[i], argv[optind]);
+				status = 1;
+			}
+		}
+		if (seconds > 0 && !benchmark(&table, &input, seconds))
+			return 1;
+		free(input.data);
+	}
+	minute_table_free(&table);
+	return status;
+}
@@ -0,0 +1,868 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Text is decoded in two passes over 64-byte blocks: the first one builds
+ * a bit mask of the separators of the block, ',' ';' and '\n', with SSE2
+ * when available and eight bytes at a time otherwise, and the second one
+ * walks the set bits to cut fields and lines without looking at the other
+ * bytes. Timestamps only have a fixed layout to check: the date is parsed
+ * once per day and compared with memcmp otherwise, and the time of day is
+ * checked and converted as a single 8-byte word.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "minute_decoder.h"
+#include "wire_format.h"
+
+#define BLOCK_SIZE 64
+#define FIELDS_MAX 16
+#define TIMESTAMP_LENGTH 20
+#define MINUTE_FIELDS 8
+#define ROLLUP_FIELDS 10
+
+#define ONES 0x0101010101010101ull
+#define HIGH_BITS 0x8080808080808080ull
+/* the digits of "HH:MM:SS" */
+#define TIME_DIGITS 0xFFFF00FFFF00FFFFull
+
+struct minute_record {
+	int32_t		key;
+	uint16_t	span;
+	uint16_t	invalid;
+	uint16_t	steps;
+	uint8_t		yaw;
+	uint8_t		pitch;
+	uint32_t	vmc;
+	uint16_t	vmc_max;
+	uint8_t		light;
+	uint8_t		activity;
+	uint8_t		hr;
+	uint8_t		hr_min;
+	uint8_t		hr_max;
+};
+
+struct field {
+	const char	*begin;
+	const char	*end;
+	char		separator;	/* the one after the field */
+};
+
+struct text_decoder {
+	struct minute_table	*table;
+	struct decode_error	*error;
+	const char		*text;
+	size_t			line;
+	char			date[10];	/* "YYYY-MM-DD" of date_key */
+	int32_t			date_key;
+	bool			date_valid;
+	bool			overflow;
+	uint8_t			count;
+	struct field		field[FIELDS_MAX];
+};
+
+/* load_le64 - 8 bytes as a little-endian word */
+static inline uint64_t
+load_le64(const void *p) {
+	uint64_t word;
+
+	memcpy(&word, p, sizeof word);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
+	return word;
+}
+
+/* days_from_civil - days since the epoch of a proleptic Gregorian date */
+static int32_t
+days_from_civil(int32_t year, unsigned month, unsigned day) {
+	int32_t era;
+	unsigned year_of_era, day_of_year, day_of_era;
+
+	year -= month <= 2;
+	era = (year >= 0 ? year : year - 399) / 400;
+	year_of_era = (unsigned)(year - era * 400);
+	day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5
+	    + day - 1;
+	day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100
+	    + day_of_year;
+	return era * 146097 + (int32_t)day_of_era - 719468;
+}
+
+/* civil_from_days - the inverse of days_from_civil */
+static void
+civil_from_days(int32_t days, int32_t *year, unsigned *month,
+    unsigned *day) {
+	int32_t era;
+	unsigned day_of_era, year_of_era, day_of_year, shifted_month;
+
+	days += 719468;
+	era = (days >= 0 ? days : days - 146096) / 146097;
+	day_of_era = (unsigned)(days - era * 146097);
+	year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524
+	    - day_of_era / 146096) / 365;
+	day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4
+	    - year_of_era / 100);
+	shifted_month = (5 * day_of_year + 2) / 153;
+	*day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+	*month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+	*year = (int32_t)year_of_era + era * 400 + (*month <= 2);
+}
+
+static uint8_t
+days_in_month(int32_t year, unsigned month) {
+	static const uint8_t days[12] =
+	    { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+	if (month == 2 && year % 4 == 0
+	    && (year % 100 != 0 || year % 400 == 0))
+		return 29;
+	return days[month - 1];
+}
+
+/* table */
+
+void
+minute_table_init(struct minute_table *table) {
+	memset(table, 0, sizeof *table);
+}
+
+/* minute_table_clear - forget the records, keeping the memory */
+void
+minute_table_clear(struct minute_table *table) {
+	table->count = 0;
+	table->resolution = 0;
+}
+
+void
+minute_table_free(struct minute_table *table) {
+	free(table->key);
+	free(table->span);
+	free(table->invalid);
+	free(table->steps);
+	free(table->yaw);
+	free(table->pitch);
+	free(table->vmc);
+	free(table->vmc_max);
+	free(table->light);
+	free(table->activity);
+	free(table->hr);
+	free(table->hr_min);
+	free(table->hr_max);
+	minute_table_init(table);
+}
+
+/* table_reserve - make room for count more records */
+static bool
+table_reserve(struct minute_table *table, size_t count) {
+	size_t capacity = table->capacity ? table->capacity : 4096;
+
+	if (table->count + count <= table->capacity) return true;
+	while (capacity < table->count + count) capacity *= 2;
+
+#define GROW(column) do { \
+		void *grown = realloc(table->column, \
+		    capacity * sizeof *table->column); \
+		if (!grown) return false; \
+		table->column = grown; \
+	} while (0)
+	GROW(key);
+	GROW(span);
+	GROW(invalid);
+	GROW(steps);
+	GROW(yaw);
+	GROW(pitch);
+	GROW(vmc);
+	GROW(vmc_max);
+	GROW(light);
+	GROW(activity);
+	GROW(hr);
+	GROW(hr_min);
+	GROW(hr_max);
+#undef GROW
+
+	table->capacity = capacity;
+	return true;
+}
+
+/* table_append - store a record, once room has been reserved for it */
+static inline void
+table_append(struct minute_table *table, const struct minute_record *r) {
+	size_t i = table->count++;
+
+	table->key[i] = r->key;
+	table->span[i] = r->span;
+	table->invalid[i] = r->invalid;
+	table->steps[i] = r->steps;
+	table->yaw[i] = r->yaw;
+	table->pitch[i] = r->pitch;
+	table->vmc[i] = r->vmc;
+	table->vmc_max[i] = r->vmc_max;
+	table->light[i] = r->light;
+	table->activity[i] = r->activity;
+	table->hr[i] = r->hr;
+	table->hr_min[i] = r->hr_min;
+	table->hr_max[i] = r->hr_max;
+}
+
+/* text input */
+
+#ifdef __SSE2__
+/* separator_mask - bit i set when block[i] is a separator */
+static inline uint64_t
+separator_mask(const uint8_t *block) {
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i semicolon = _mm_set1_epi8(';');
+	const __m128i newline = _mm_set1_epi8('\n');
+	uint64_t mask = 0;
+
+	for (int i = 0; i < BLOCK_SIZE; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i *)(block + i));
+		__m128i hits = _mm_or_si128(_mm_or_si128(
+		    _mm_cmpeq_epi8(bytes, comma),
+		    _mm_cmpeq_epi8(bytes, semicolon)),
+		    _mm_cmpeq_epi8(bytes, newline));
+		mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hits) << i;
+	}
+	return mask;
+}
+#else
+/* byte_matches - 0x80 in each byte of word equal to c, exactly */
+static inline uint64_t
+byte_matches(uint64_t word, uint8_t c) {
+	uint64_t x = word ^ (ONES * c);
+	return ~(((x & ~HIGH_BITS) + ~HIGH_BITS) | x) & HIGH_BITS;
+}
+
+/* separator_mask - bit i set when block[i] is a separator */
+static inline uint64_t
+separator_mask(const uint8_t *block) {
+	uint64_t mask = 0;
+
+	for (int i = 0; i < BLOCK_SIZE; i += 8) {
+		uint64_t word = load_le64(block + i);
+		uint64_t hits = byte_matches(word, ',')
+		    | byte_matches(word, ';') | byte_matches(word, '\n');
+		/* gather the high bit of each byte into the top byte */
+		mask |= (((hits >> 7) * 0x0102040810204080ull) >> 56) << i;
+	}
+	return mask;
+}
+#endif
+
+static bool
+text_fail(struct text_decoder *decoder, const char *at, const char *message) {
+	decoder->error->message = message;
+	decoder->error->offset = at - decoder->text;
+	decoder->error->line = decoder->line;
+	return false;
+}
+
+static inline bool
+field_empty(const struct field *field) {
+	return field->begin == field->end;
+}
+
+/* parse_uint - value of a field of decimal digits, at most max */
+static inline bool
+parse_uint(const struct field *field, uint32_t max, uint32_t *value) {
+	const char *p = field->begin;
+	uint64_t result = 0;
+
+	if (p == field->end || field->end - p > 10) return false;
+	for (; p < field->end; p += 1) {
+		unsigned digit = (unsigned)(*p - '0');
+		if (digit > 9) return false;
+		result = result * 10 + digit;
+	}
+	if (result > max) return false;
+	*value = (uint32_t)result;
+	return true;
+}
+
+static inline bool
+parse_2digits(const char *p, unsigned *value) {
+	unsigned high = (unsigned)(p[0] - '0'), low = (unsigned)(p[1] - '0');
+	if (high > 9 || low > 9) return false;
+	*value = high * 10 + low;
+	return true;
+}
+
+/* parse_date - set the cached date from "YYYY-MM-DD" */
+static bool
+parse_date(struct text_decoder *decoder, const char *p) {
+	unsigned century, year, month, day;
+
+	if (!parse_2digits(p, &century) || !parse_2digits(p + 2, &year)
+	    || p[4] != '-' || !parse_2digits(p + 5, &month) || p[7] != '-'
+	    || !parse_2digits(p + 8, &day))
+		return false;
+	year += 100 * century;
+	if (month < 1 || month > 12 || day < 1
+	    || day > days_in_month(year, month))
+		return false;
+
+	decoder->date_key = days_from_civil(year, month, day) * 1440;
+	memcpy(decoder->date, p, sizeof decoder->date);
+	decoder->date_valid = true;
+	return true;
+}
+
+/* parse_timestamp - minute key of "YYYY-MM-DDTHH:MM:SSZ" */
+static inline bool
+parse_timestamp(struct text_decoder *decoder, const struct field *field,
+    int32_t *key) {
+	const char *p = field->begin;
+	uint64_t time, digits;
+
+	if (field->end - p != TIMESTAMP_LENGTH || p[10] != 'T'
+	    || p[13] != ':' || p[16] != ':' || p[19] != 'Z')
+		return false;
+	/* the date only changes every 1440 lines */
+	if ((!decoder->date_valid
+	    || memcmp(p, decoder->date, sizeof decoder->date))
+	    && !parse_date(decoder, p))
+		return false;
+
+	/* every digit of "HH:MM:SS" has 3 as its high nibble, */
+	/* and still has it after adding 6 */
+	time = load_le64(p + 11);
+	if ((time & 0xF0F0F0F0F0F0F0F0ull & TIME_DIGITS)
+	    != (0x3030303030303030ull & TIME_DIGITS)
+	    || ((time + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull
+	    & TIME_DIGITS) != (0x3030303030303030ull & TIME_DIGITS))
+		return false;
+	digits = time - 0x3030303030303030ull;
+
+	unsigned hour = (digits & 0xFF) * 10 + ((digits >> 8) & 0xFF);
+	unsigned minute = ((digits >> 24) & 0xFF) * 10 + ((digits >> 32) & 0xFF);
+	unsigned second = ((digits >> 48) & 0xFF) * 10 + ((digits >> 56) & 0xFF);
+	if (hour > 23 || minute > 59 || second > 59) return false;
+	*key = decoder->date_key + hour * 60 + minute;
+	return true;
+}
+
+/* parse_key - signed minute key of a queued record */
+static bool
+parse_key(const struct field *field, int32_t *key) {
+	struct field digits = *field;
+	bool negative = digits.begin < digits.end && *digits.begin == '-';
+	uint32_t value;
+
+	digits.begin += negative;
+	if (!parse_uint(&digits, negative ? 0x80000000u : INT32_MAX, &value))
+		return false;
+	*key = negative ? (int32_t)(0u - value) : (int32_t)value;
+	return true;
+}
+
+/* decode_minute - fill record from the fields after the timestamp */
+static bool
+decode_minute(struct text_decoder *decoder, const struct field *f,
+    struct minute_record *r) {
+	uint32_t steps, yaw, pitch, vmc, light, activity, hr;
+
+	if (!parse_uint(f + 5, UINT8_MAX, &activity))
+		return text_fail(decoder, f[5].begin, "bad activity");
+	r->activity = activity;
+
+	if (field_empty(f)) {
+		/* invalid minute */
+		for (int i = 1; i < MINUTE_FIELDS - 1; i += 1) {
+			if (i != 5 && !field_empty(f + i))
+				return text_fail(decoder, f[i].begin,
+				    "invalid minute with data");
+		}
+		r->invalid = r->span;
+		return true;
+	}
+
+	if (!parse_uint(f, UINT16_MAX, &steps))
+		return text_fail(decoder, f[0].begin, "bad steps");
+	if (!parse_uint(f + 1, 15, &yaw))
+		return text_fail(decoder, f[1].begin, "bad yaw");
+	if (!parse_uint(f + 2, 15, &pitch))
+		return text_fail(decoder, f[2].begin, "bad pitch");
+	if (!parse_uint(f + 3, UINT16_MAX, &vmc))
+		return text_fail(decoder, f[3].begin, "bad vmc");
+	if (!parse_uint(f + 4, WIRE_FLAG_LIGHT_MASK, &light))
+		return text_fail(decoder, f[4].begin, "bad light");
+	if (!parse_uint(f + 6, UINT8_MAX, &hr))
+		return text_fail(decoder, f[6].begin, "bad heart rate");
+
+	r->steps = steps;
+	r->yaw = yaw;
+	r->pitch = pitch;
+	r->vmc = r->vmc_max = vmc;
+	r->light = light;
+	r->hr = r->hr_min = r->hr_max = hr;
+	return true;
+}
+
+/* decode_rollup - fill record from the fields after the timestamp */
+static bool
+decode_rollup(struct text_decoder *decoder, const struct field *f,
+    struct minute_record *r) {
+	uint32_t invalid, steps, vmc, vmc_max, hr_min = 0, hr = 0, hr_max = 0;
+	uint32_t activity, light;
+
+	if (!parse_uint(f, r->span, &invalid))
+		return text_fail(decoder, f[0].begin, "bad invalid count");
+	if (!parse_uint(f + 1, UINT16_MAX, &steps))
+		return text_fail(decoder, f[1].begin, "bad steps");
+	if (!parse_uint(f + 2, UINT32_MAX, &vmc))
+		return text_fail(decoder, f[2].begin, "bad vmc");
+	if (!parse_uint(f + 3, UINT16_MAX, &vmc_max))
+		return text_fail(decoder, f[3].begin, "bad vmc maximum");
+	/* the heart rate is empty without samples */
+	if (!(field_empty(f + 4) && field_empty(f + 5) && field_empty(f + 6))
+	    && (!parse_uint(f + 4, UINT8_MAX, &hr_min)
+	    || !parse_uint(f + 5, UINT8_MAX, &hr)
+	    || !parse_uint(f + 6, UINT8_MAX, &hr_max) || !hr))
+		return text_fail(decoder, f[4].begin, "bad heart rate");
+	if (!parse_uint(f + 7, UINT8_MAX, &activity))
+		return text_fail(decoder, f[7].begin, "bad activity");
+	if (!parse_uint(f + 8, UINT8_MAX, &light))
+		return text_fail(decoder, f[8].begin, "bad light");
+
+	r->invalid = invalid;
+	r->steps = steps;
+	r->vmc = vmc;
+	r->vmc_max = vmc_max;
+	r->hr_min = hr_min;
+	r->hr = hr;
+	r->hr_max = hr_max;
+	r->activity = activity;
+	r->light = light;
+	return true;
+}
+
+/* decode_line - store the record of the fields of a line */
+static bool
+decode_line(struct text_decoder *decoder) {
+	const struct field *f = decoder->field;
+	uint8_t count = decoder->count;
+	uint8_t first = 0, last;
+	int32_t record_key = 0;
+	uint32_t span = 1, resolution = 1;
+	bool rollup = false;
+	struct minute_record r;
+
+	if (f[0].separator == ';') {
+		if (!parse_key(f, &record_key))
+			return text_fail(decoder, f[0].begin, "bad key");
+		first = 1;
+	}
+
+	/* the CSV fields run up to the next ';' */
+	for (last = first; last + 1 < count && f[last].separator != ';';
+	    last += 1);
+	if (last + 1 < count) {
+		const struct field *extra = f + last + 1;
+		struct field digits = *extra;
+
+		if (!first || last + 2 != count)
+			return text_fail(decoder, extra->begin,
+			    "unexpected ';'");
+		rollup = !field_empty(extra) && *extra->begin == 'r';
+		digits.begin += rollup;
+		if (rollup && (!parse_uint(&digits, UINT8_MAX, &resolution)
+		    || resolution < 2))
+			return text_fail(decoder, extra->begin,
+			    "bad rollup resolution");
+		if (!rollup && (!parse_uint(&digits, UINT16_MAX, &span)
+		    || !span))
+			return text_fail(decoder, extra->begin, "bad run length");
+	}
+	if (last - first + 1 != (rollup ? ROLLUP_FIELDS : MINUTE_FIELDS))
+		return text_fail(decoder, f[first].begin,
+		    "wrong number of fields");
+
+	memset(&r, 0, sizeof r);
+	if (!parse_timestamp(decoder, f + first, &r.key))
+		return text_fail(decoder, f[first].begin, "bad timestamp");
+	if (first && r.key != record_key)
+		return text_fail(decoder, f[first].begin,
+		    "timestamp does not match the key");
+
+	if (decoder->table->resolution
+	    && decoder->table->resolution != resolution)
+		return text_fail(decoder, f[first].begin,
+		    "minutes and rollups of other resolutions mixed");
+
+	if (rollup) {
+		r.span = resolution;
+		if (!decode_rollup(decoder, f + first + 1, &r)) return false;
+	} else {
+		r.span = span;
+		if (!decode_minute(decoder, f + first + 1, &r)) return false;
+	}
+
+	if (!table_reserve(decoder->table, 1))
+		return text_fail(decoder, f[first].begin, "out of memory");
+	decoder->table->resolution = resolution;
+	table_append(decoder->table, &r);
+	return true;
+}
+
+/* end_field - record the field from begin up to its separator at end */
+static inline void
+end_field(struct text_decoder *decoder, const char *begin, const char *end,
+    char separator) {
+	struct field *field;
+
+	if (decoder->count >= FIELDS_MAX) {
+		decoder->overflow = true;
+		return;
+	}
+	field = decoder->field + decoder->count++;
+	field->begin = begin;
+	field->end = end;
+	field->separator = separator;
+}
+
+/* end_line - decode the fields of the line from begin to end */
+static bool
+end_line(struct text_decoder *decoder, const char *begin, const char *end) {
+	bool result = true;
+
+	decoder->line += 1;
+	if (end > begin && end[-1] == '\r') {
+		end -= 1;
+		decoder->field[decoder->count - 1].end -= 1;
+	}
+	if (begin < end && *begin != '#') {
+		result = decoder->overflow
+		    ? text_fail(decoder, begin, "too many fields")
+		    : decode_line(decoder);
+	}
+	decoder->count = 0;
+	decoder->overflow = false;
+	return result;
+}
+
+/* minute_decode_text - append the records of text to the table */
+bool
+minute_decode_text(struct minute_table *table, const char *text,
+    size_t size, struct decode_error *error) {
+	struct text_decoder decoder;
+	const char *field_begin = text;
+	const char *line_begin = text;
+	uint8_t tail[BLOCK_SIZE];
+
+	memset(&decoder, 0, sizeof decoder);
+	decoder.table = table;
+	decoder.error = error;
+	decoder.text = text;
+
+	for (size_t block = 0; block < size; block += BLOCK_SIZE) {
+		const char *base = text + block;
+		uint64_t mask;
+
+		if (size - block >= BLOCK_SIZE) {
+			mask = separator_mask((const uint8_t *)base);
+		} else {
+			memset(tail, 0, sizeof tail);
+			memcpy(tail, base, size - block);
+			mask = separator_mask(tail);
+		}
+
+		while (mask) {
+			const char *p = base + __builtin_ctzll(mask);
+			mask &= mask - 1;
+			end_field(&decoder, field_begin, p, *p);
+			field_begin = p + 1;
+			if (*p != '\n') continue;
+			if (!end_line(&decoder, line_begin, p)) return false;
+			line_begin = p + 1;
+		}
+	}
+
+	/* last line without terminator */
+	if (line_begin < text + size) {
+		end_field(&decoder, field_begin, text + size, '\n');
+		if (!end_line(&decoder, line_begin, text + size)) return false;
+	}
+	return true;
+}
+
+/* binary input */
+
+static bool
+binary_fail(struct decode_error *error, size_t offset, const char *message) {
+	error->message = message;
+	error->offset = offset;
+	error->line = 0;
+	return false;
+}
+
+/* minute_is_binary - whether data starts like a dataBinary block */
+bool
+minute_is_binary(const uint8_t *data, size_t size) {
+	return size >= WIRE_HEADER_SIZE && data[0] >= 1
+	    && data[0] <= WIRE_FORMAT_VERSION
+	    && (data[1] == WIRE_TYPE_MINUTE || data[1] == WIRE_TYPE_ROLLUP);
+}
+
+/* decode_minute_block - append the count minute records at p */
+static void
+decode_minute_block(struct minute_table *table, const uint8_t *p,
+    uint8_t count, int32_t key) {
+	struct minute_record r;
+
+	for (uint8_t n = 0; n < count; n += 1, p += WIRE_RECORD_SIZE) {
+		uint8_t flags = p[3];
+
+		memset(&r, 0, sizeof r);
+		key += p[0];
+		r.key = key;
+		r.span = (flags & WIRE_FLAG_RUN) ? wire_get_u16(p + 4) : 1;
+		r.activity = p[6];
+		if (flags & WIRE_FLAG_INVALID) {
+			r.invalid = r.span;
+		} else {
+			r.steps = p[1];
+			r.yaw = p[2] & 0xF;
+			r.pitch = p[2] >> 4;
+			r.vmc = r.vmc_max = (flags & WIRE_FLAG_RUN)
+			    ? 0 : wire_get_u16(p + 4);
+			r.light = flags & WIRE_FLAG_LIGHT_MASK;
+			r.hr = r.hr_min = r.hr_max = p[7];
+		}
+		table_append(table, &r);
+		key += r.span - 1;
+	}
+}
+
+/* decode_rollup_block - append the count rollup records at p */
+static void
+decode_rollup_block(struct minute_table *table, const uint8_t *p,
+    uint8_t count, uint8_t resolution, int32_t key) {
+	struct minute_record r;
+
+	for (uint8_t n = 0; n < count; n += 1, p += WIRE_ROLLUP_SIZE) {
+		memset(&r, 0, sizeof r);
+		key += p[0];
+		r.key = key;
+		r.span = resolution;
+		r.invalid = p[1];
+		r.steps = wire_get_u16(p + 2);
+		r.vmc = (uint32_t)wire_get_i32(p + 4);
+		r.vmc_max = wire_get_u16(p + 8);
+		if (p[11]) {
+			r.hr_min = p[10];
+			r.hr = p[11];
+			r.hr_max = p[12];
+		}
+		r.activity = p[13];
+		r.light = p[14];
+		table_append(table, &r);
+		key += resolution - 1;
+	}
+}
+
+/* minute_decode_binary - append the records of a sequence of blocks */
+bool
+minute_decode_binary(struct minute_table *table, const uint8_t *data,
+    size_t size, struct decode_error *error) {
+	size_t offset = 0;
+
+	while (offset < size) {
+		const uint8_t *block = data + offset;
+		uint8_t type, resolution, count;
+		size_t record_size;
+
+		if (size - offset < WIRE_HEADER_SIZE)
+			return binary_fail(error, offset, "truncated header");
+		if (!minute_is_binary(block, size - offset))
+			return binary_fail(error, offset,
+			    "unsupported block version or type");
+
+		type = block[1];
+		count = block[3];
+		resolution = (type == WIRE_TYPE_ROLLUP) ? block[2] : 1;
+		record_size = (type == WIRE_TYPE_ROLLUP)
+		    ? WIRE_ROLLUP_SIZE : WIRE_RECORD_SIZE;
+		if (size - offset < WIRE_HEADER_SIZE + count * record_size)
+			return binary_fail(error, offset, "truncated block");
+		if (type == WIRE_TYPE_ROLLUP && resolution < 2)
+			return binary_fail(error, offset + 2,
+			    "bad rollup resolution");
+		if (table->resolution && table->resolution != resolution)
+			return binary_fail(error, offset,
+			    "minutes and rollups of other resolutions mixed");
+		if (!table_reserve(table, count))
+			return binary_fail(error, offset, "out of memory");
+
+		table->resolution = resolution;
+		if (type == WIRE_TYPE_ROLLUP)
+			decode_rollup_block(table, block + WIRE_HEADER_SIZE,
+			    count, resolution, wire_get_i32(block + 4));
+		else
+			decode_minute_block(table, block + WIRE_HEADER_SIZE,
+			    count, wire_get_i32(block + 4));
+		offset += WIRE_HEADER_SIZE + count * record_size;
+	}
+	return true;
+}
+
+/* output */
+
+static char *
+format_uint(char *p, uint32_t value) {
+	char digits[10];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (n) *p++ = digits[--n];
+	return p;
+}
+
+static char *
+format_2digits(char *p, unsigned value) {
+	p[0] = '0' + value / 10;
+	p[1] = '0' + value % 10;
+	return p + 2;
+}
+
+/* format_timestamp - write "YYYY-MM-DDTHH:MM:00Z" for a minute key */
+static char *
+format_timestamp(char *p, int32_t key) {
+	int32_t days = key >= 0 ? key / 1440 : -((1439 - key) / 1440);
+	int32_t minute = key - days * 1440;
+	int32_t year;
+	unsigned month, day;
+
+	civil_from_days(days, &year, &month, &day);
+	p = format_2digits(p, (unsigned)year / 100 % 100);
+	p = format_2digits(p, (unsigned)year % 100);
+	*p++ = '-';
+	p = format_2digits(p, month);
+	*p++ = '-';
+	p = format_2digits(p, day);
+	*p++ = 'T';
+	p = format_2digits(p, minute / 60);
+	*p++ = ':';
+	p = format_2digits(p, minute % 60);
+	memcpy(p, ":00Z", 4);
+	return p + 4;
+}
+
+static char *
+format_field(char *p, uint32_t value) {
+	*p++ = ',';
+	return format_uint(p, value);
+}
+
+/* minute_format_record - write the record at index as a queued record, */
+/*    "key;line" with ";N" for runs and ";rN" for rollups; the buffer */
+/*    needs MINUTE_RECORD_MAX bytes, and is not NUL-terminated */
+size_t
+minute_format_record(const struct minute_table *table, size_t i,
+    char *buffer) {
+	char *p = buffer;
+	int32_t key = table->key[i];
+
+	if (key < 0) *p++ = '-';
+	p = format_uint(p, key < 0 ? 0u - (uint32_t)key : (uint32_t)key);
+	*p++ = ';';
+	p = format_timestamp(p, key);
+
+	if (table->resolution > 1) {
+		p = format_field(p, table->invalid[i]);
+		p = format_field(p, table->steps[i]);
+		p = format_field(p, table->vmc[i]);
+		p = format_field(p, table->vmc_max[i]);
+		if (table->hr[i]) {
+			p = format_field(p, table->hr_min[i]);
+			p = format_field(p, table->hr[i]);
+			p = format_field(p, table->hr_max[i]);
+		} else {
+			memcpy(p, ",,,", 3);
+			p += 3;
+		}
+		p = format_field(p, table->activity[i]);
+		p = format_field(p, table->light[i]);
+		memcpy(p, ";r", 2);
+		return format_uint(p + 2, table->span[i]) - buffer;
+	}
+
+	if (table->invalid[i]) {
+		memcpy(p, ",,,,,", 5);
+		p = format_field(p + 5, table->activity[i]);
+		*p++ = ',';
+	} else {
+		p = format_field(p, table->steps[i]);
+		p = format_field(p, table->yaw[i]);
+		p = format_field(p, table->pitch[i]);
+		p = format_field(p, table->vmc[i]);
+		p = format_field(p, table->light[i]);
+		p = format_field(p, table->activity[i]);
+		p = format_field(p, table->hr[i]);
+	}
+	if (table->span[i] > 1) {
+		*p++ = ';';
+		p = format_uint(p, table->span[i]);
+	}
+	return p - buffer;
+}
+
+/* fnv1a - running FNV-1a hash */
+static uint32_t
+fnv1a(uint32_t hash, const uint8_t *data, size_t size) {
+	while (size--) hash = (hash ^ *data++) * 16777619u;
+	return hash;
+}
+
+/* minute_table_hash - hash of the fields of every minute, runs expanded */
+/*    into single minutes, so that every encoding of the same minutes */
+/*    hashes the same */
+uint32_t
+minute_table_hash(const struct minute_table *table) {
+	uint32_t hash = 2166136261u;
+	uint8_t bytes[21];
+
+	for (size_t i = 0; i < table->count; i += 1) {
+		uint16_t minutes = table->resolution > 1 ? 1 : table->span[i];
+
+		wire_put_u16(bytes + 4, table->resolution > 1
+		    ? table->invalid[i] : table->invalid[i] != 0);
+		wire_put_u16(bytes + 6, table->steps[i]);
+		bytes[8] = table->yaw[i];
+		bytes[9] = table->pitch[i];
+		wire_put_u32(bytes + 10, table->vmc[i]);
+		wire_put_u16(bytes + 14, table->vmc_max[i]);
+		bytes[16] = table->light[i];
+		bytes[17] = table->activity[i];
+		bytes[18] = table->hr[i];
+		bytes[19] = table->hr_min[i];
+		bytes[20] = table->hr_max[i];
+		for (uint16_t j = 0; j < minutes; j += 1) {
+			wire_put_i32(bytes, table->key[i] + j);
+			hash = fnv1a(hash, bytes, sizeof bytes);
+		}
+	}
+	return hash;
+}
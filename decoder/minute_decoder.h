@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Decoder of the exported minute records into columns.
+ *
+ * Text input holds one record per line: either a CSV line as built by
+ * minute_data_image, "timestamp,steps,yaw,pitch,vmc,light,activity,hr"
+ * with empty fields but the activity for an invalid minute, or a record
+ * queued by the phone, "key;line", "key;line;N" for a run of N identical
+ * minutes, or "key;rollup;rN" for a rollup of N minutes, whose line is
+ * "timestamp,invalid,steps,vmc,vmcMax,hrMin,hrAvg,hrMax,activity,light".
+ * Empty lines and lines starting with '#' are skipped, so that traces
+ * decode as they are.
+ *
+ * Binary input is a sequence of dataBinary blocks, laid out as described
+ * in src/c/wire_format.h.
+ *
+ * A table holds either minutes, or rollups of a single resolution. A
+ * minute reads as the rollup of itself: vmc_max is its vmc and the three
+ * heart rate columns hold the same reading.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* longest record written by minute_format_record, without terminator */
+#define MINUTE_RECORD_MAX 96
+
+struct minute_table {
+	size_t		count;
+	size_t		capacity;
+	uint8_t		resolution;	/* 1 for minutes, 0 while empty */
+	int32_t		*key;		/* first minute of each record */
+	uint16_t	*span;		/* minutes covered by each record */
+	uint16_t	*invalid;	/* minutes of the record without data */
+	uint16_t	*steps;
+	uint8_t		*yaw;
+	uint8_t		*pitch;
+	uint32_t	*vmc;
+	uint16_t	*vmc_max;
+	uint8_t		*light;
+	uint8_t		*activity;
+	uint8_t		*hr;		/* average bpm, 0 without samples */
+	uint8_t		*hr_min;
+	uint8_t		*hr_max;
+};
+
+struct decode_error {
+	const char	*message;
+	size_t		offset;		/* bytes from the start of the input */
+	size_t		line;		/* from 1, or 0 for binary input */
+};
+
+void
+minute_table_init(struct minute_table *table);
+
+void
+minute_table_clear(struct minute_table *table);
+
+void
+minute_table_free(struct minute_table *table);
+
+bool
+minute_is_binary(const uint8_t *data, size_t size);
+
+bool
+minute_decode_text(struct minute_table *table, const char *text,
+    size_t size, struct decode_error *error);
+
+bool
+minute_decode_binary(struct minute_table *table, const uint8_t *data,
+    size_t size, struct decode_error *error);
+
+size_t
+minute_format_record(const struct minute_table *table, size_t index,
+    char *buffer);
+
+uint32_t
+minute_table_hash(const struct minute_table *table);
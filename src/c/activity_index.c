@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "activity_index.h"
+
+/* sweep_rewind - go back to the state before the first minute */
+static void
+sweep_rewind(struct activity_index *index) {
+	index->cursor = 0;
+	index->position = 0;
+	index->mask = 0;
+	memset(index->depth, 0, sizeof index->depth);
+}
+
+void
+activity_index_reset(struct activity_index *index) {
+	index->count = 0;
+	sweep_rewind(index);
+}
+
+/* activity_index_add - record activity over minutes [first, last) */
+/*    returns false when the index is full */
+bool
+activity_index_add(struct activity_index *index, HealthActivity activity,
+    uint16_t first, uint16_t last) {
+	uint8_t bit = 0;
+
+	if (first >= last || !activity) return true;
+
+	while (bit < ACTIVITY_BIT_COUNT && !(activity & (1 << bit)))
+		bit += 1;
+	if (bit >= ACTIVITY_BIT_COUNT) {
+		APP_LOG(APP_LOG_LEVEL_WARNING,
+		    "Ignoring unexpected activity 0x%x", (unsigned)activity);
+		return true;
+	}
+
+	if (index->count + 2 > ACTIVITY_BOUNDARY_MAX) {
+		APP_LOG(APP_LOG_LEVEL_ERROR,
+		    "Too many activities in page, dropping the rest");
+		return false;
+	}
+
+	index->boundary[index->count++] = (struct activity_boundary){
+	    .index = first, .bit = bit, .delta = 1 };
+	index->boundary[index->count++] = (struct activity_boundary){
+	    .index = last, .bit = bit, .delta = -1 };
+	return true;
+}
+
+/* activity_index_add_interval - record activity from start_time to */
+/*    end_time over minutes starting at first, of which there are size */
+/*    returns false when the index is full */
+bool
+activity_index_add_interval(struct activity_index *index,
+    HealthActivity activity, time_t start_time, time_t end_time,
+    time_t first, uint16_t size) {
+	uint16_t first_index, last_index;
+
+	if (end_time <= first) return true;
+
+	if (start_time <= first) {
+		first_index = 0;
+	} else {
+		first_index = (start_time - first) / 60;
+	}
+	if (first_index >= size) return true;
+
+	last_index = (end_time - first + 59) / 60;
+	if (last_index > size) {
+		last_index = size;
+	}
+
+	return activity_index_add(index, activity, first_index, last_index);
+}
+
+/* activity_index_sort - order boundaries by minute, to be called once */
+/*    all the activities are added; insertion sort is enough since */
+/*    activities come mostly in chronological order */
+void
+activity_index_sort(struct activity_index *index) {
+	for (uint16_t i = 1; i < index->count; i += 1) {
+		struct activity_boundary item = index->boundary[i];
+		uint16_t j = i;
+
+		while (j > 0 && index->boundary[j - 1].index > item.index) {
+			index->boundary[j] = index->boundary[j - 1];
+			j -= 1;
+		}
+		index->boundary[j] = item;
+	}
+	sweep_rewind(index);
+}
+
+/* activity_index_mask - activity mask of the given minute */
+/*    O(1) amortized for non-decreasing minutes, rewinds otherwise */
+HealthActivityMask
+activity_index_mask(struct activity_index *index, uint16_t minute) {
+	if (minute < index->position) sweep_rewind(index);
+	index->position = minute;
+
+	while (index->cursor < index->count
+	    && index->boundary[index->cursor].index <= minute) {
+		struct activity_boundary *b = index->boundary + index->cursor;
+
+		index->depth[b->bit] += b->delta;
+		if (index->depth[b->bit])
+			index->mask |= 1 << b->bit;
+		else
+			index->mask &= ~(1 << b->bit);
+		index->cursor += 1;
+	}
+
+	return index->mask;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "platform.h"
+
+/* two boundaries per activity interval */
+#define ACTIVITY_BOUNDARY_MAX 256
+#define ACTIVITY_BIT_COUNT 8
+
+struct activity_boundary {
+	uint16_t	index;
+	uint8_t		bit;
+	int8_t		delta;
+};
+
+/* activity intervals of a page of minutes, as sorted interval boundaries */
+/* swept lazily by activity_index_mask */
+struct activity_index {
+	struct activity_boundary boundary[ACTIVITY_BOUNDARY_MAX];
+	uint16_t	count;
+	uint16_t	cursor;
+	uint16_t	position;
+	uint8_t		depth[ACTIVITY_BIT_COUNT];
+	HealthActivityMask mask;
+};
+
+void
+activity_index_reset(struct activity_index *index);
+
+bool
+activity_index_add(struct activity_index *index, HealthActivity activity,
+    uint16_t first, uint16_t last);
+
+bool
+activity_index_add_interval(struct activity_index *index,
+    HealthActivity activity, time_t start_time, time_t end_time,
+    time_t first, uint16_t size);
+
+void
+activity_index_sort(struct activity_index *index);
+
+HealthActivityMask
+activity_index_mask(struct activity_index *index, uint16_t minute);
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "key_ranges.h"
+
+void
+key_ranges_reset(struct key_ranges *set) {
+	set->count = 0;
+}
+
+/* key_ranges_add - insert keys [first, last], merging the ranges they */
+/*    overlap or touch; when the set is full the highest range is */
+/*    forgotten, which only means sending its minutes again */
+void
+key_ranges_add(struct key_ranges *set, int32_t first, int32_t last) {
+	uint8_t i = 0, j;
+
+	if (first > last) return;
+
+	/* first range that may merge: ending at first - 1 or later */
+	while (i < set->count && set->range[i].last < first - 1)
+		i += 1;
+
+	/* ranges [i, j) overlap or touch the new one */
+	j = i;
+	while (j < set->count && set->range[j].first <= last + 1) {
+		if (set->range[j].first < first) first = set->range[j].first;
+		if (set->range[j].last > last) last = set->range[j].last;
+		j += 1;
+	}
+
+	if (i == j) {
+		if (set->count >= KEY_RANGES_MAX) {
+			if (i >= KEY_RANGES_MAX) return;
+			set->count -= 1;
+		}
+		memmove(set->range + i + 1, set->range + i,
+		    (set->count - i) * sizeof set->range[0]);
+		set->count += 1;
+	} else if (j > i + 1) {
+		memmove(set->range + i + 1, set->range + j,
+		    (set->count - j) * sizeof set->range[0]);
+		set->count -= j - i - 1;
+	}
+
+	set->range[i].first = first;
+	set->range[i].last = last;
+}
+
+/* key_ranges_drop_below - forget the keys before key */
+void
+key_ranges_drop_below(struct key_ranges *set, int32_t key) {
+	uint8_t i = 0;
+
+	while (i < set->count && set->range[i].last < key)
+		i += 1;
+	if (!i) return;
+
+	memmove(set->range, set->range + i,
+	    (set->count - i) * sizeof set->range[0]);
+	set->count -= i;
+}
+
+/* key_ranges_skip - first key from key on that is not in the set */
+int32_t
+key_ranges_skip(const struct key_ranges *set, int32_t key) {
+	for (uint8_t i = 0; i < set->count && set->range[i].first <= key; i++)
+		if (set->range[i].last >= key) return set->range[i].last + 1;
+	return key;
+}
+
+/* key_ranges_next - first key of the set after key, INT32_MAX if none */
+int32_t
+key_ranges_next(const struct key_ranges *set, int32_t key) {
+	for (uint8_t i = 0; i < set->count; i++)
+		if (set->range[i].first > key) return set->range[i].first;
+	return INT32_MAX;
+}
+
+void
+key_ranges_load(struct key_ranges *set, uint32_t persist_key) {
+	int size = persist_read_data(persist_key, set, sizeof *set);
+
+	if (size < 1 || set->count > KEY_RANGES_MAX
+	    || size < (int)(offsetof(struct key_ranges, range)
+	    + set->count * sizeof set->range[0]))
+		set->count = 0;
+}
+
+void
+key_ranges_save(const struct key_ranges *set, uint32_t persist_key) {
+	persist_write_data(persist_key, set, offsetof(struct key_ranges, range)
+	    + set->count * sizeof set->range[0]);
+}
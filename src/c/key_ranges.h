@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "platform.h"
+
+#define KEY_RANGES_MAX 16
+
+/* set of minute keys, as sorted disjoint ranges of consecutive keys */
+struct key_ranges {
+	uint8_t		count;
+	struct key_range {
+		int32_t	first;
+		int32_t	last;
+	}		range[KEY_RANGES_MAX];
+};
+
+void
+key_ranges_reset(struct key_ranges *set);
+
+void
+key_ranges_add(struct key_ranges *set, int32_t first, int32_t last);
+
+void
+key_ranges_drop_below(struct key_ranges *set, int32_t key);
+
+int32_t
+key_ranges_skip(const struct key_ranges *set, int32_t key);
+
+int32_t
+key_ranges_next(const struct key_ranges *set, int32_t key);
+
+void
+key_ranges_load(struct key_ranges *set, uint32_t persist_key);
+
+void
+key_ranges_save(const struct key_ranges *set, uint32_t persist_key);
@@ -17,25 +17,112 @@
 #include <inttypes.h>
 #include <pebble.h>
 
+#include "activity_index.h"
 #include "dict_tools.h"
+#include "key_ranges.h"
+#include "perf_stats.h"
+#include "persist_ring.h"
 #include "progress_layer.h"
+#include "rollup.h"
+#include "text_format.h"
+#include "wire_encoder.h"
+#include "wire_format.h"
+
+/* upper bound of the outbox, to keep the batch buffer within diorite heap */
+#define OUTBOX_SIZE_LIMIT 4096
+/* settings sent from the configuration page: two persisted strings, the
+ * lastSent decimal string, two short choices and eight numbers or toggles */
+#define INBOX_SIZE dict_calc_buffer_size(13, \
+    PERSIST_STRING_MAX_LENGTH, PERSIST_STRING_MAX_LENGTH, 12, 8, 8, \
+    4, 4, 4, 4, 4, 4, 4, 4)
+/* longest line produced by minute_data_image, terminator included */
+#define MINUTE_LINE_MAX 64
+/* minutes of history per page, two pages are kept to prefetch the next one */
+#define PAGE_MINUTES 720
+/* delay before loading the next page, to let the outbox send first */
+#define PREFETCH_DELAY_MS 20
+/* minimum delay between two writes of the upload checkpoint */
+#define CHECKPOINT_INTERVAL 60
+/* default minimum delay between two screen updates */
+#define FRAME_BUDGET_MS 1000
+/* minutes after which missing history is not expected to show up */
+#define HISTORY_SETTLE_MINUTES 60
+/* first delays before sending a failed message again, doubled per failure */
+#define RETRY_BUSY_MS 50
+#define RETRY_TIMEOUT_MS 1000
+#define RETRY_OTHER_MS 250
+#define RETRY_MAX_MS 16000
+/* default number of consecutive failures before giving up */
+#define RETRY_BUDGET 10
+
+/* a page of minute history and its activities */
+struct minute_page {
+	HealthMinuteData	data[PAGE_MINUTES];
+	struct activity_index	activity;
+	time_t			first;
+	time_t			last;
+	uint16_t		size;
+	bool			loaded;
+};
 
 static Window *window;
 static TextLayer *modal_text_layer;
 static char modal_text[256];
-static HealthMinuteData minute_data[1440];
-static HealthActivityMask minute_activity[1440];
-static uint16_t minute_data_size = 0;
+static TextLayer *stats_text_layer;
+static char stats_text[256];
+static bool stats_displayed = false;
+static uint32_t outbox_send_time = 0;
+static struct minute_page pages[2];
+static struct minute_page *page = pages;
+static struct minute_page *next_page = pages + 1;
+static AppTimer *prefetch_timer = 0;
 static uint16_t minute_index = 0;
-static time_t minute_first = 0, minute_last = 0;
+static struct rollup rollup;
+static uint16_t page_loads = 0;
+static uint16_t page_stalls = 0;
+static uint32_t page_stall_ms = 0;
 static bool modal_displayed = false;
-static bool display_dirty = false;
-static char global_buffer[1024];
+static AppTimer *redraw_timer = 0;
+static uint32_t redraw_time = 0;
+static uint32_t cfg_frame_budget = FRAME_BUDGET_MS;
+static uint32_t outbox_size = 0;
+static char global_buffer[OUTBOX_SIZE_LIMIT];
 static bool sending_data = false;
 static bool cfg_auto_close = false;
+static bool cfg_csv_lines = false;
+static uint8_t cfg_resolution = 1;
 static bool auto_close = false;
 static int cfg_wakeup_time = -1;
 static int32_t last_key = 0;
+static uint32_t checkpoint_key = 0;
+static uint32_t checkpoint_saved = 0;
+static time_t checkpoint_time = 0;
+static struct persist_ring ring;
+static bool ring_owned = false;
+static bool staged_in_flight = false;
+static bool cfg_background_collect = false;
+static int32_t in_flight_key = 0;
+static bool offline = false;
+static int32_t resume_key = 0;
+static AppTimer *stage_timer = 0;
+static uint8_t staged_blocks = 0;
+static uint32_t in_flight_minutes = 0;
+static struct key_ranges acked;
+static bool acked_dirty = false;
+static uint32_t upload_first = 0;
+static bool cfg_newest_first = false;
+static int32_t export_first_key = 0;
+static time_t export_top = 0;
+static time_t window_first = 0;
+static time_t window_end = 0;
+static AppTimer *retry_timer = 0;
+static uint16_t send_failures = 0;
+static uint16_t cfg_retry_budget = RETRY_BUDGET;
+static bool gave_up = false;
+/* set by Resend until the phone gets a message marked as sent after it */
+static bool resend_echo = false;
+static bool resend_echo_in_flight = false;
+static time_t web_failed_start = 0;
 
 static char * cfg_auth_token;
 static char * cfg_endpoint;
@@ -48,6 +135,8 @@ static struct widget {
 	ProgressLayer	*progress_layer;
 	uint32_t	first_key;
 	uint32_t	current_key;
+	uint32_t	label_key;
+	uint32_t	done;		/* minutes sent or uploaded */
 	time_t		start_time;
 } phone, web;
 
@@ -56,45 +145,112 @@ close_app(void) {
 	window_stack_pop_all(true);
 }
 
+/* update_visibility - show the modal message, the statistics screen */
+/*    or the progress widgets */
+static void
+update_visibility(void) {
+	bool hide_modal = !modal_displayed || stats_displayed;
+	bool hide_progress = modal_displayed || stats_displayed;
+
+	layer_set_hidden(text_layer_get_layer(modal_text_layer), hide_modal);
+	layer_set_hidden(text_layer_get_layer(stats_text_layer),
+	    !stats_displayed);
+	layer_set_hidden(text_layer_get_layer(phone.label_layer),
+	    hide_progress);
+	layer_set_hidden(text_layer_get_layer(phone.rate_layer), hide_progress);
+	layer_set_hidden(phone.progress_layer, hide_progress);
+	layer_set_hidden(text_layer_get_layer(web.label_layer), hide_progress);
+	layer_set_hidden(text_layer_get_layer(web.rate_layer), hide_progress);
+	layer_set_hidden(web.progress_layer, hide_progress);
+}
+
 static void
 set_modal_mode(bool is_modal) {
 	if (is_modal == modal_displayed) return;
-	layer_set_hidden(text_layer_get_layer(modal_text_layer), !is_modal);
-	layer_set_hidden(text_layer_get_layer(phone.label_layer), is_modal);
-	layer_set_hidden(text_layer_get_layer(phone.rate_layer), is_modal);
-	layer_set_hidden(phone.progress_layer, is_modal);
-	layer_set_hidden(text_layer_get_layer(web.label_layer), is_modal);
-	layer_set_hidden(text_layer_get_layer(web.rate_layer), is_modal);
-	layer_set_hidden(web.progress_layer, is_modal);
 	modal_displayed = is_modal;
+	update_visibility();
+}
+
+static void
+update_stats(void) {
+	perf_format(stats_text, sizeof stats_text);
+	layer_mark_dirty(text_layer_get_layer(stats_text_layer));
+}
+
+/* select_click_handler - toggle the statistics screen */
+static void
+select_click_handler(ClickRecognizerRef recognizer, void *context) {
+	(void)recognizer;
+	(void)context;
+	stats_displayed = !stats_displayed;
+	if (stats_displayed) update_stats();
+	update_visibility();
+}
+
+static void
+click_config_provider(void *context) {
+	(void)context;
+	window_single_click_subscribe(BUTTON_ID_SELECT, &select_click_handler);
+}
+
+/* export_span - number of minutes of the export, for the progress */
+static int32_t
+export_span(void) {
+	time_t now = time(0);
+	int32_t first = cfg_newest_first ? export_first_key
+	    : (int32_t)phone.first_key;
+	int32_t end = cfg_newest_first ? export_top / 60
+	    : (last_key ? last_key + 1 : (now + 59) / 60);
+
+	return end > first ? end - first : 1;
 }
 
+/* update_half_progress - refresh the layers of a widget */
+/*    marking dirty only those whose content changed */
 static void
 update_half_progress(struct widget *widget) {
 	if (!widget || !widget->current_key) return;
 
 	time_t t, now = time(0);
 	struct tm *tm;
-	int32_t key_span = (last_key ? last_key : (now + 59) / 60)
-	    - widget->first_key;
-	int32_t keys_done = widget->current_key - widget->first_key + 1;
+	char rate[sizeof widget->rate];
+	int32_t key_span = export_span();
+	int32_t keys_done = widget->done;
 	int32_t running_time = widget->start_time
 	    ? now - widget->start_time : 0;
 
+	if (keys_done > key_span) keys_done = key_span;
 	progress_layer_set_progress(widget->progress_layer,
 	    (keys_done * 100 + key_span / 2) / key_span);
 
-	t = widget->current_key * 60;
-	tm = localtime(&t);
-	strftime(widget->label, sizeof widget->label, "%F %H:%M", tm);
+	if (widget->label_key != widget->current_key) {
+		t = widget->current_key * 60;
+		tm = localtime(&t);
+		strftime(widget->label, sizeof widget->label,
+		    "%F %H:%M", tm);
+		widget->label_key = widget->current_key;
+		layer_mark_dirty(text_layer_get_layer(widget->label_layer));
+	}
 
-	if (last_key > 0 && widget->current_key == (uint32_t)last_key) {
-		snprintf(widget->rate, sizeof widget->rate, "DONE");
+	if (widget == &phone && offline) {
+		snprintf(rate, sizeof rate, "OFFLINE");
+	} else if (widget == &phone && gave_up) {
+		snprintf(rate, sizeof rate, "FAILED");
+	} else if (widget == &phone && retry_timer) {
+		snprintf(rate, sizeof rate, "RETRY %u", (unsigned)send_failures);
+	} else if (last_key > 0 && widget->done >= phone.done) {
+		snprintf(rate, sizeof rate, "DONE");
 	} else if (running_time > 0) {
-		int32_t i = ((widget->current_key - widget->first_key) * 60
-		    + running_time / 2) / running_time;
-		snprintf(widget->rate, sizeof widget->rate,
-		    "%" PRIi32 " /min", i);
+		int32_t i = (widget->done * 60 + running_time / 2)
+		    / running_time;
+		snprintf(rate, sizeof rate, "%" PRIi32 " /min", i);
+	} else {
+		return;
+	}
+
+	if (strcmp(rate, widget->rate)) {
+		memcpy(widget->rate, rate, sizeof widget->rate);
+		layer_mark_dirty(text_layer_get_layer(widget->rate_layer));
 	}
 }
 
@@ -102,7 +258,35 @@ static void
 update_progress(void) {
 	update_half_progress(&phone);
 	update_half_progress(&web);
-	display_dirty = false;
+	if (stats_displayed) update_stats();
+}
+
+/* resume_web_rate - replace the upload failure with the rate again */
+static void
+resume_web_rate(void) {
+	if (web.start_time) return;
+	web.start_time = web_failed_start ? web_failed_start : time(0);
+	web_failed_start = 0;
+	web.rate[0] = 0;
+	layer_mark_dirty(text_layer_get_layer(web.rate_layer));
+}
+
+static void
+redraw_callback(void *context) {
+	(void)context;
+	redraw_timer = 0;
+	redraw_time = perf_clock();
+	update_progress();
+}
+
+/* schedule_redraw - update the screen once the frame budget allows it */
+static void
+schedule_redraw(void) {
+	uint32_t elapsed = perf_clock() - redraw_time;
+
+	if (redraw_timer) return;
+	redraw_timer = app_timer_register(elapsed < cfg_frame_budget
+	    ? cfg_frame_budget - elapsed : 0, &redraw_callback, 0);
 }
 
 #define PROGRESS_HEIGHT 10
@@ -123,6 +307,12 @@ window_load(Window *window) {
 	    fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD));
 	layer_add_child(window_layer, text_layer_get_layer(modal_text_layer));
 
+	stats_text_layer = text_layer_create(bounds);
+	text_layer_set_text(stats_text_layer, stats_text);
+	text_layer_set_font(stats_text_layer,
+	    fonts_get_system_font(FONT_KEY_GOTHIC_14));
+	layer_add_child(window_layer, text_layer_get_layer(stats_text_layer));
+
 	phone.rate_layer = text_layer_create(GRect(0,
 	    bounds.size.h / 2 - LABEL_MARGIN - 2 * LABEL_HEIGHT,
 	    bounds.size.w,
@@ -185,12 +375,17 @@ window_load(Window *window) {
 	    fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
 	layer_add_child(window_layer, text_layer_get_layer(web.rate_layer));
 
-	set_modal_mode(true);
+	modal_displayed = true;
+	update_visibility();
 }
 
 static void
 window_unload(Window *window) {
+	(void)window;
 	text_layer_destroy(modal_text_layer);
+	text_layer_destroy(stats_text_layer);
+	if (redraw_timer) app_timer_cancel(redraw_timer);
+	redraw_timer = 0;
 	text_layer_destroy(phone.label_layer);
 	text_layer_destroy(web.label_layer);
 	progress_layer_destroy(phone.progress_layer);
@@ -209,192 +404,751 @@ set_modal_message(const char *msg) {
 static uint16_t
 minute_data_image(char *buffer, size_t size,
     HealthMinuteData *data, HealthActivityMask activity_mask, time_t key) {
-	struct tm *tm;
-	size_t ret;
+	static struct utc_clock clock;
+	char *p;
 	if (!buffer || !data) return 0;
 
-	tm = gmtime(&key);
-	if (!tm) {
+	if (size < MINUTE_LINE_MAX) {
 		APP_LOG(APP_LOG_LEVEL_ERROR,
-		    "Unable to get UTC time for %" PRIi32, key);
+		    "minute_data_image: buffer of %zu is too small", size);
 		return 0;
 	}
 
-	ret = strftime(buffer, size, "%FT%TZ", tm);
-	if (!ret) {
+	p = buffer + utc_clock_format(&clock, buffer, key);
+	if (p == buffer) {
 		APP_LOG(APP_LOG_LEVEL_ERROR,
 		    "Unable to build RFC-3339 representation of %" PRIi32,
-		    key);
+		    (int32_t)key);
 		return 0;
 	}
 
-	if (ret >= size) {
-		APP_LOG(APP_LOG_LEVEL_ERROR,
-		    "Unexpected return value %zu of strftime on buffer %zu",
-		    ret, size);
-		return 0;
+	if (data->is_invalid) {
+		memcpy(p, ",,,,,,", 6);
+		p = format_uint(p + 6, activity_mask);
+		*p++ = ',';
+		*p = 0;
+		return p - buffer;
 	}
 
-	if (data->is_invalid) {
-		int i = snprintf(buffer + ret, size - ret,
-		    ",,,,,,%" PRIu32 ",", activity_mask);
+	*p++ = ',';
+	p = format_uint(p, data->steps);
+	*p++ = ',';
+	p = format_uint(p, data->orientation & 0xF);
+	*p++ = ',';
+	p = format_uint(p, data->orientation >> 4);
+	*p++ = ',';
+	p = format_uint(p, data->vmc);
+	*p++ = ',';
+	p = format_uint(p, data->light);
+	*p++ = ',';
+	p = format_uint(p, activity_mask);
+	*p++ = ',';
+	p = format_uint(p, data->heart_rate_bpm);
+	*p = 0;
+
+	return p - buffer;
+}
 
-		if (i <= 0) {
-			APP_LOG(APP_LOG_LEVEL_ERROR, "minute_data_image: "
-			    "Unexpected return value %d of snprintf (i)", i);
-			return 0;
+/* csv_batch - fill global_buffer with newline-separated CSV lines */
+/*    of consecutive minutes, returns the used size without terminator */
+static size_t
+csv_batch(size_t capacity, int32_t *first_key, int32_t *end_key) {
+	size_t used = 0;
+
+	*first_key = (page->first + 60 * minute_index) / 60;
+
+	while (minute_index < page->size
+	    && capacity - used >= MINUTE_LINE_MAX) {
+		uint16_t size = minute_data_image(global_buffer + used,
+		    capacity - used,
+		    page->data + minute_index,
+		    activity_index_mask(&page->activity, minute_index),
+		    page->first + 60 * minute_index);
+		if (!size) {
+			/* skip a lone failing minute, otherwise end the batch */
+			/* before it to keep the keys consecutive */
+			if (!used) {
+				minute_index += 1;
+				*first_key += 1;
+				continue;
+			}
+			break;
 		}
-		return ret + i;
-	}
-
-	uint16_t yaw = data->orientation & 0xF;
-	uint16_t pitch = data->orientation >> 4;
-
-	int i = snprintf(buffer + ret, size - ret,
-	    ",%" PRIu8 ",%" PRIu16 ",%" PRIu16 ",%" PRIu16 ",%d,%" PRIu32
-	      ",%" PRIu8,
-	    data->steps,
-	    yaw,
-	    pitch,
-	    data->vmc,
-	    (int)data->light,
-	    activity_mask,
-	    data->heart_rate_bpm);
-
-	if (i <= 0) {
-		APP_LOG(APP_LOG_LEVEL_ERROR, "minute_data_image: "
-		    "Unexpected return value %d of snprintf", i);
-		return 0;
+		used += size;
+		global_buffer[used++] = '\n';
+		minute_index += 1;
 	}
 
-	return ret + i;
+	if (!used) return 0;
+	*end_key = (page->first + 60 * (minute_index - 1)) / 60;
+	global_buffer[used - 1] = 0;
+	return used - 1;
+}
+
+/* binary_batch - fill global_buffer with a wire format block */
+/*    collapsing runs of idle minutes into a single record */
+static size_t
+binary_batch(size_t capacity, int32_t *first_key, int32_t *end_key) {
+	size_t used;
+
+	*first_key = (page->first + 60 * minute_index) / 60;
+	used = wire_encode_minutes((uint8_t *)global_buffer, capacity,
+	    page->data, &page->activity, minute_index, page->size,
+	    page->first / 60, &minute_index);
+
+	if (!used) return 0;
+	*end_key = (page->first + 60 * (minute_index - 1)) / 60;
+	return used;
 }
 
-/* send_minute_data - use AppMessage to send the given minute data to phone */
-static void send_minute_data(HealthMinuteData *data, HealthActivityMask activity_mask,
-    time_t key) {
-	int32_t int_key = key / 60;
+/* rollup_batch - fill global_buffer with a wire format block of rollups */
+/*    a bucket is only sent once a minute of the next one is seen, */
+/*    so the last one waits for a later export */
+static size_t
+rollup_batch(size_t capacity, int32_t *first_key, int32_t *end_key) {
+	uint8_t *buffer = (uint8_t *)global_buffer;
+	size_t used = WIRE_HEADER_SIZE;
+	uint8_t count = 0;
+
+	while (minute_index < page->size) {
+		int32_t key = (page->first + 60 * minute_index) / 60;
+
+		if (!rollup_accepts(&rollup, key)) {
+			int32_t delta = count ? rollup.key - *end_key : 0;
+
+			if (count >= WIRE_RECORD_COUNT_MAX
+			    || used + WIRE_ROLLUP_SIZE > capacity
+			    || delta > UINT8_MAX)
+				break;
+
+			if (!count) *first_key = rollup.key;
+			rollup_record(&rollup, buffer + used, delta);
+			*end_key = rollup_last_key(&rollup);
+			used += WIRE_ROLLUP_SIZE;
+			count += 1;
+			rollup_reset(&rollup, rollup.resolution);
+		}
+
+		rollup_add(&rollup, key, page->data + minute_index,
+		    activity_index_mask(&page->activity, minute_index));
+		minute_index += 1;
+	}
+
+	if (!count) return 0;
+	wire_put_header(buffer, WIRE_TYPE_ROLLUP, rollup.resolution, count,
+	    *first_key);
+	return used;
+}
+
+static void send_next_line(void);
+static void send_failed(AppMessageResult reason);
+
+/* send_minute_batch - use AppMessage to send as many minutes as fit */
+/*    either as CSV lines (dataKey of the first minute and dataLine) */
+/*    or as a wire format block (dataBinary) */
+static void
+send_minute_batch(void) {
+	uint16_t first_index = minute_index;
+	time_t key = page->first + 60 * first_index;
+	int32_t int_key, end_key;
+	size_t used;
+	size_t capacity = outbox_size - (cfg_csv_lines
+	    ? dict_calc_buffer_size(2, sizeof int_key, 1)
+	    : dict_calc_buffer_size(1, 0));
+
+	if (resend_echo)
+		capacity -= dict_calc_buffer_size(1, 1) - dict_calc_buffer_size(0);
+	if (capacity > sizeof global_buffer)
+		capacity = sizeof global_buffer;
 
 	if (key % 60 != 0) {
 		APP_LOG(APP_LOG_LEVEL_WARNING,
 		    "Discarding %" PRIi32 " second from time key %" PRIi32,
-		    key % 60, int_key);
+		    (int32_t)(key % 60), (int32_t)(key / 60));
 	}
 
-	uint16_t size = minute_data_image(global_buffer, sizeof global_buffer,
-	    data, activity_mask, key);
-	if (!size) return;
+	uint32_t start_time = perf_clock();
+	if (cfg_csv_lines)
+		used = csv_batch(capacity, &int_key, &end_key);
+	else if (rollup.resolution > 1)
+		used = rollup_batch(capacity, &int_key, &end_key);
+	else
+		used = binary_batch(capacity, &int_key, &end_key);
+	perf_record(PERF_ENCODE, start_time);
+
+	if (!used) {
+		/* nothing could be encoded, move on instead of stalling */
+		send_next_line();
+		return;
+	}
 
 	AppMessageResult msg_result;
 	DictionaryIterator *iter;
+	in_flight_key = int_key;
+	in_flight_minutes = 0;
+	resend_echo_in_flight = resend_echo;
 	msg_result = app_message_outbox_begin(&iter);
 
 	if (msg_result) {
 		APP_LOG(APP_LOG_LEVEL_ERROR,
-		    "send_minute_data: app_message_outbox_begin returned %d",
+		    "send_minute_batch: app_message_outbox_begin returned %d",
 		    (int)msg_result);
+		send_failed(msg_result);
 		return;
 	}
 
 	DictionaryResult dict_result;
-	dict_result = dict_write_int(iter, MESSAGE_KEY_dataKey,
-	    &int_key, sizeof int_key, true);
-	if (dict_result != DICT_OK) {
-		APP_LOG(APP_LOG_LEVEL_ERROR,
-		    "send_minute_data: [%d] unable to add data key %" PRIi32,
-		    (int)dict_result, int_key);
-	}
+	if (cfg_csv_lines) {
+		dict_result = dict_write_int(iter, MESSAGE_KEY_dataKey,
+		    &int_key, sizeof int_key, true);
+		if (dict_result != DICT_OK) {
+			APP_LOG(APP_LOG_LEVEL_ERROR,
+			    "send_minute_batch: [%d] unable to add data key %"
+			    PRIi32, (int)dict_result, int_key);
+		}
 
-	dict_result = dict_write_cstring(iter,
-	    MESSAGE_KEY_dataLine, global_buffer);
+		dict_result = dict_write_cstring(iter,
+		    MESSAGE_KEY_dataLine, global_buffer);
+	} else {
+		dict_result = dict_write_data(iter, MESSAGE_KEY_dataBinary,
+		    (uint8_t *)global_buffer, used);
+	}
 	if (dict_result != DICT_OK) {
 		APP_LOG(APP_LOG_LEVEL_ERROR,
-		    "send_minute_data: [%d] unable to add data line \"%s\"",
-		    (int)dict_result, global_buffer);
+		    "send_minute_batch: [%d] unable to add %zu bytes of data",
+		    (int)dict_result, used);
 	}
+	/* the phone drops the messages it received before this one */
+	if (resend_echo) dict_write_uint8(iter, MESSAGE_KEY_resend, 1);
 
+	outbox_send_time = perf_clock();
+	perf_stats.outbox_bytes += used;
 	msg_result = app_message_outbox_send();
-  
+
 	if (msg_result) {
 		APP_LOG(APP_LOG_LEVEL_ERROR,
-		    "send_minute_data: app_message_outbox_send returned %d",
+		    "send_minute_batch: app_message_outbox_send returned %d",
 		    (int)msg_result);
 	}
 
 	if (!phone.first_key) phone.first_key = int_key;
-	phone.current_key = int_key;
-	display_dirty = true;
+	phone.current_key = end_key;
+	in_flight_minutes = end_key - int_key + 1;
+	phone.done += in_flight_minutes;
+	if (msg_result) send_failed(msg_result);
+	schedule_redraw();
 }
 
 static bool record_activity(HealthActivity activity, time_t start_time, time_t end_time,
     void *context) {
-	uint16_t first_index, last_index;
+	struct minute_page *target = context;
+
+	return activity_index_add_interval(&target->activity, activity,
+	    start_time, end_time, target->first, target->size);
+}
+
+static bool ring_usable(void);
+
+static bool load_minute_data_page(struct minute_page *target, time_t start,
+    time_t end) {
+	uint32_t start_time = perf_clock();
+
+	/* stop before the minutes staged by the worker */
+	if (ring_usable() && ring.count > 0 && ring.first_key * 60 > start
+	    && ring.first_key * 60 < end)
+		end = ring.first_key * 60;
+
+	target->first = start;
+	target->last = end;
+	target->size = health_service_get_minute_history(target->data,
+	    ARRAY_LENGTH(target->data),
+	    &target->first, &target->last);
+	perf_record(PERF_HISTORY, start_time);
+	target->loaded = true;
+	page_loads += 1;
+
+	activity_index_reset(&target->activity);
+	if (!target->size) {
+		target->first = target->last = end;
+		return false;
+	}
+
+	if (health_service_any_activity_accessible(HealthActivityMaskAll,
+	    target->first, target->last)
+	    == HealthServiceAccessibilityMaskAvailable) {
+		start_time = perf_clock();
+		health_service_activities_iterate(HealthActivityMaskAll,
+		    target->first, target->last,
+		    HealthIterationDirectionFuture,
+		    &record_activity,
+		    target);
+		activity_index_sort(&target->activity);
+		perf_record(PERF_ACTIVITIES, start_time);
+	}
+
+	return true;
+}
+
+/* set_window - make current the newest-first window holding time t */
+/*    windows are PAGE_MINUTES long, from export_top down */
+static void
+set_window(time_t t) {
+	int32_t n = (t < export_top) ? (export_top - t - 1) / (PAGE_MINUTES * 60)
+	    : 0;
+
+	window_end = export_top - n * PAGE_MINUTES * 60;
+	window_first = window_end - PAGE_MINUTES * 60;
+	if (window_first < export_first_key * 60)
+		window_first = export_first_key * 60;
+}
+
+/* next_range - minutes [*first, *end) to read from position on, */
+/*    skipping those already uploaded, and moving to the next older */
+/*    window once the current one is done in newest-first order */
+/*    returns false when the export is complete */
+static bool
+next_range(time_t position, time_t *first, time_t *end) {
+	time_t limit = time(0);
+	int32_t key, next;
+
+	for (;;) {
+		if (cfg_newest_first) {
+			if (window_end <= export_first_key * 60) return false;
+			if (position < window_first) position = window_first;
+			limit = window_end;
+		}
+
+		key = key_ranges_skip(&acked, position / 60);
+		if (key != position / 60) position = (time_t)key * 60;
+
+		if (position < limit) {
+			next = key_ranges_next(&acked, key);
+			*first = position;
+			*end = (next < limit / 60) ? (time_t)next * 60 : limit;
+			return true;
+		}
+
+		if (!cfg_newest_first) return false;
+		window_end = window_first;
+		set_window(window_end - 1);
+		position = window_first;
+	}
+}
+
+static void ack_range(int32_t first, int32_t last);
+
+/* mark_done - account minutes [first, end) without history as sent */
+/*    and uploaded, once they are too old to still show up */
+static void
+mark_done(time_t first, time_t end) {
+	int32_t first_key = first / 60, end_key = end / 60;
+
+	if (!cfg_newest_first || first_key >= end_key) return;
+	if (end > time(0) - HISTORY_SETTLE_MINUTES * 60) return;
+	phone.done += end_key - first_key;
+	ack_range(first_key, end_key - 1);
+}
+
+/* load_next_page - load into target the next minutes to send after */
+/*    position, returns false when there are none left */
+static bool
+load_next_page(struct minute_page *target, time_t position) {
+	time_t first, end;
+
+	while (next_range(position, &first, &end)) {
+		if (load_minute_data_page(target, first, end)) {
+			mark_done(first, target->first);
+			return true;
+		}
+		mark_done(first, end);
+		position = target->last;
+	}
+
+	target->size = 0;
+	target->first = target->last = position;
+	target->loaded = true;
+	return false;
+}
+
+static void
+prefetch_callback(void *context) {
 	(void)context;
+	prefetch_timer = 0;
+	if (!next_page->loaded) load_next_page(next_page, page->last);
+}
 
-	if (start_time <= minute_first) {
-		first_index = 0;
-	} else {
-		first_index = (start_time - minute_first) / 60;
+static void
+cancel_prefetch(void) {
+	if (prefetch_timer) app_timer_cancel(prefetch_timer);
+	prefetch_timer = 0;
+	next_page->loaded = false;
+}
+
+/* next_minute_page - swap in the prefetched page, loading it if needed */
+/*    returns false when there is no more history to send */
+static bool
+next_minute_page(void) {
+	struct minute_page *swap;
+
+	if (prefetch_timer) {
+		app_timer_cancel(prefetch_timer);
+		prefetch_timer = 0;
 	}
-	if (first_index >= minute_data_size) return true;
 
-	last_index = (end_time - minute_first + 59) / 60;
-	if (last_index > minute_data_size) {
-		last_index = minute_data_size;
+	if (!next_page->loaded) {
+		uint32_t start_time = perf_clock();
+		load_next_page(next_page, page->last);
+		page_stalls += 1;
+		page_stall_ms += perf_clock() - start_time;
 	}
 
-	for (uint16_t i = first_index; i < last_index; i += 1) {
-		minute_activity[i] |= activity;
+	swap = page;
+	page = next_page;
+	next_page = swap;
+	next_page->loaded = false;
+	minute_index = 0;
+
+	if (!page->size) {
+		APP_LOG(APP_LOG_LEVEL_INFO,
+		    "history exhausted after %" PRIu16 " page loads,"
+		    " %" PRIu16 " stalls for %" PRIu32 " ms",
+		    page_loads, page_stalls, page_stall_ms);
+		return false;
 	}
 
+	prefetch_timer = app_timer_register(PREFETCH_DELAY_MS,
+	    &prefetch_callback, 0);
 	return true;
 }
 
-static bool load_minute_data_page(time_t start) {
-	minute_first = start;
-	minute_last = time(0);
-	minute_data_size = health_service_get_minute_history(minute_data,
-	    ARRAY_LENGTH(minute_data),
-	    &minute_first, &minute_last);
+/* save_checkpoint - persist the last key acknowledged by the web */
+/*    and the uploaded ranges after it */
+/*    at most every CHECKPOINT_INTERVAL seconds unless forced */
+static void
+save_checkpoint(bool force) {
+	time_t now = time(0);
+
+	if (checkpoint_key == checkpoint_saved && !acked_dirty) return;
+	if (!force && now - checkpoint_time < CHECKPOINT_INTERVAL) return;
+
+	persist_write_int(MESSAGE_KEY_lastSent, checkpoint_key);
+	if (acked_dirty) key_ranges_save(&acked, MESSAGE_KEY_uploadDone);
+	checkpoint_saved = checkpoint_key;
+	acked_dirty = false;
+	checkpoint_time = now;
+}
+
+/* reset_checkpoint - forget the saved progress, e.g. to resend */
+static void
+reset_checkpoint(uint32_t ikey) {
+	checkpoint_key = ikey;
+	key_ranges_reset(&acked);
+	acked_dirty = true;
+	save_checkpoint(true);
+}
+
+/* advance_checkpoint - skip the minutes up to ikey, keeping the uploaded */
+/*    ranges after it */
+static void
+advance_checkpoint(uint32_t ikey) {
+	checkpoint_key = ikey;
+	key_ranges_drop_below(&acked, ikey + 1);
+	acked_dirty = true;
+	save_checkpoint(true);
+}
+
+/* ack_range - record minutes [first, last] as uploaded, moving the */
+/*    checkpoint to the end of the uploaded minutes that follow it */
+static void
+ack_range(int32_t first, int32_t last) {
+	int32_t prefix = checkpoint_key;
+
+	if (first > last) return;
+	key_ranges_add(&acked, first, last);
+	acked_dirty = true;
+	web.done += last - first + 1;
+
+	if (!cfg_newest_first) {
+		/* uploads come in order */
+		if (last > prefix) prefix = last;
+	} else {
+		if (prefix < export_first_key - 1)
+			prefix = export_first_key - 1;
+		prefix = key_ranges_skip(&acked, prefix + 1) - 1;
+	}
+
+	if (prefix > (int32_t)checkpoint_key) checkpoint_key = prefix;
+}
+
+/* ring_usable - whether blocks of the ring can be sent as is */
+static bool
+ring_usable(void) {
+	return ring_owned && !cfg_csv_lines && rollup.resolution == 1
+	    && !cfg_newest_first;
+}
+
+/* move_to - continue the history at the given minute */
+static void
+move_to(int32_t key) {
+	cancel_prefetch();
 	minute_index = 0;
+	page->size = 0;
+	page->first = page->last = key * 60;
+}
 
-	memset(minute_activity, 0, sizeof minute_activity);
-	if (health_service_any_activity_accessible(HealthActivityMaskAll,
-	    minute_first, minute_last)
-	    == HealthServiceAccessibilityMaskAvailable) {
-		health_service_activities_iterate(HealthActivityMaskAll,
-		    minute_first, minute_last,
-		    HealthIterationDirectionFuture,
-		    &record_activity,
-		    0);
+/* rewind_to - send again the minutes from the given one */
+static void
+rewind_to(int32_t key) {
+	time_t t = (time_t)key * 60;
+
+	if (page->size && t >= page->first
+	    && t < page->first + 60 * (time_t)page->size) {
+		/* still in the current page, no need to load it again */
+		minute_index = (t - page->first) / 60;
+	} else {
+		if (cfg_newest_first) set_window(t);
+		move_to(key);
+	}
+	rollup_reset(&rollup, rollup.resolution);
+	if (phone.first_key >= (uint32_t)key) {
+		phone.first_key = phone.current_key = 0;
+	} else {
+		phone.current_key = key - 1;
 	}
+}
 
-	if (!minute_data_size) {
-		APP_LOG(APP_LOG_LEVEL_ERROR,
-		    "health_service_get_minute_history returned 0");
-		// minute_first = minute_last = 0;
+/* send_staged_block - send the block of the ring starting at the end */
+/*    of the current page, dropping the older ones */
+/*    returns whether a block is being sent */
+static bool
+send_staged_block(void) {
+	int32_t next_key = page->last / 60;
+	size_t size;
+
+	/* the first message after Resend comes from send_minute_batch */
+	if (!ring_usable() || resend_echo) return false;
+	while (ring.count > 0 && ring.first_key < next_key)
+		persist_ring_pop(&ring);
+	if (!ring.count || ring.first_key != next_key) return false;
+
+	size = persist_ring_peek(&ring, (uint8_t *)global_buffer,
+	    sizeof global_buffer);
+	if (!size) {
+		persist_ring_clear(&ring);
 		return false;
 	}
 
+	AppMessageResult msg_result;
+	DictionaryIterator *iter;
+	in_flight_key = ring.first_key;
+	in_flight_minutes = 0;
+	msg_result = app_message_outbox_begin(&iter);
+
+	if (msg_result) {
+		APP_LOG(APP_LOG_LEVEL_ERROR,
+		    "send_staged_block: app_message_outbox_begin returned %d",
+		    (int)msg_result);
+		send_failed(msg_result);
+		return true;
+	}
+
+	dict_write_data(iter, MESSAGE_KEY_dataBinary,
+	    (uint8_t *)global_buffer, size);
+	outbox_send_time = perf_clock();
+	perf_stats.outbox_bytes += size;
+	msg_result = app_message_outbox_send();
+
+	if (msg_result) {
+		APP_LOG(APP_LOG_LEVEL_ERROR,
+		    "send_staged_block: app_message_outbox_send returned %d",
+		    (int)msg_result);
+	}
+
+	staged_in_flight = true;
+	if (!phone.first_key) phone.first_key = ring.first_key;
+	phone.current_key = wire_block_last_key((uint8_t *)global_buffer);
+	in_flight_minutes = phone.current_key - ring.first_key + 1;
+	phone.done += in_flight_minutes;
+
+	/* resume the history after the block */
+	move_to(phone.current_key + 1);
+	if (msg_result) send_failed(msg_result);
+	schedule_redraw();
 	return true;
 }
 
 static void
 send_next_line(void) {
-	if (minute_index >= minute_data_size
-	    && !load_minute_data_page(minute_last)) {
+	if (minute_index >= page->size && send_staged_block()) return;
+
+	/* an empty page may end where the staged blocks start */
+	if (minute_index >= page->size && !next_minute_page()
+	    && !send_staged_block()) {
 		sending_data = false;
 		last_key = phone.current_key;
-		display_dirty = true;
-		if (auto_close && web.current_key >= phone.current_key)
+		schedule_redraw();
+		if (auto_close && web.done >= phone.done)
 			close_app();
 		return;
 	}
 
-	send_minute_data(minute_data + minute_index,
-	    minute_activity[minute_index],
-	    minute_first + 60 * minute_index);
-	minute_index += 1;
+	if (minute_index < page->size) send_minute_batch();
+}
+
+/* stage_callback - encode the next block of unsent minutes into the */
+/*    ring, after the blocks already there, while the phone is away */
+static void
+stage_callback(void *context) {
+	int32_t first_key, end_key;
+	int32_t key = (page->first + 60 * minute_index) / 60;
+	size_t size;
+	(void)context;
+
+	stage_timer = 0;
+	if (!offline || staged_blocks >= PERSIST_RING_CHUNK_COUNT) return;
+
+	if (minute_index >= page->size) key = page->last / 60;
+	if (ring.count > 0 && key < ring.next_key) move_to(ring.next_key);
+	if (minute_index >= page->size && !next_minute_page()) return;
+
+	size = binary_batch(PERSIST_RING_CHUNK_SIZE, &first_key, &end_key);
+	if (size && persist_ring_push(&ring, (uint8_t *)global_buffer, size,
+	    end_key + 1, true))
+		staged_blocks += 1;
+
+	stage_timer = app_timer_register(PREFETCH_DELAY_MS,
+	    &stage_callback, 0);
+}
+
+static void
+cancel_staging(void) {
+	if (stage_timer) app_timer_cancel(stage_timer);
+	stage_timer = 0;
+}
+
+/* go_offline - pause the export at the message that could not be sent */
+/*    and stage what comes next in the ring until the phone is back */
+static void
+go_offline(void) {
+	if (offline) return;
+
+	offline = true;
+	staged_in_flight = false;
+	resume_key = in_flight_key;
+	phone.done -= in_flight_minutes;
+	in_flight_minutes = 0;
+	staged_blocks = 0;
+	rewind_to(resume_key);
+	APP_LOG(APP_LOG_LEVEL_INFO,
+	    "phone disconnected, export paused at %" PRIi32, resume_key);
+
+	if (ring_usable()) {
+		stage_timer = app_timer_register(PREFETCH_DELAY_MS,
+		    &stage_callback, 0);
+	}
+	schedule_redraw();
+}
+
+/* retry_callback - send again the message that failed */
+static void
+retry_callback(void *context) {
+	(void)context;
+	retry_timer = 0;
+	if (sending_data && !offline) send_next_line();
+	schedule_redraw();
+}
+
+static void
+cancel_retry(void) {
+	if (retry_timer) app_timer_cancel(retry_timer);
+	retry_timer = 0;
+}
+
+/* send_failed - pause while the phone is disconnected, otherwise send */
+/*    the failed message again after a delay depending on the reason, */
+/*    or stop the export once the retry budget is spent */
+static void
+send_failed(AppMessageResult reason) {
+	uint32_t delay;
+
+	resend_echo_in_flight = false;
+	if (reason == APP_MSG_NOT_CONNECTED
+	    || !connection_service_peek_pebble_app_connection()) {
+		cancel_retry();
+		go_offline();
+		return;
+	}
+	if (offline || retry_timer || !sending_data) return;
+
+	staged_in_flight = false;
+	phone.done -= in_flight_minutes;
+	in_flight_minutes = 0;
+	rewind_to(in_flight_key);
+	send_failures += 1;
+
+	if (send_failures > cfg_retry_budget) {
+		APP_LOG(APP_LOG_LEVEL_ERROR,
+		    "giving up at %" PRIi32 " after %u failures",
+		    in_flight_key, (unsigned)send_failures);
+		sending_data = false;
+		gave_up = true;
+		schedule_redraw();
+		return;
+	}
+
+	switch (reason) {
+	    case APP_MSG_BUSY:
+		/* the phone is still processing a message, it will be over soon */
+		delay = RETRY_BUSY_MS;
+		break;
+	    case APP_MSG_SEND_TIMEOUT:
+		/* no acknowledgement in time, the link is slow or lossy */
+		delay = RETRY_TIMEOUT_MS;
+		break;
+	    default:
+		delay = RETRY_OTHER_MS;
+		break;
+	}
+	delay <<= (send_failures < 6 ? send_failures - 1 : 5);
+	if (delay > RETRY_MAX_MS) delay = RETRY_MAX_MS;
+
+	APP_LOG(APP_LOG_LEVEL_INFO,
+	    "sending %" PRIi32 " again in %" PRIu32 " ms",
+	    in_flight_key, delay);
+	retry_timer = app_timer_register(delay, &retry_callback, 0);
+	schedule_redraw();
+}
+
+/* connection_handler - resume a paused export, draining the ring */
+static void
+connection_handler(bool connected) {
+	if (!connected || !offline) return;
+
+	offline = false;
+	cancel_staging();
+	send_failures = 0;
+	APP_LOG(APP_LOG_LEVEL_INFO,
+	    "phone reconnected, %u blocks staged", (unsigned)staged_blocks);
+	rewind_to(resume_key);
+	if (sending_data) send_next_line();
+}
+
+/* start_newest_first - set the windows of a newest-first export */
+/*    from the first minute of history after ikey to the present */
+static void
+start_newest_first(uint32_t ikey) {
+	HealthMinuteData probe;
+	time_t now = time(0);
+	time_t first = (ikey + 1) * 60;
+	time_t end;
+
+	export_top = now - now % 60;
+	end = export_top;
+	export_first_key = export_top / 60;
+	if (first < export_top
+	    && health_service_get_minute_history(&probe, 1, &first, &end))
+		export_first_key = first / 60;
+	set_window(export_top - 1);
 }
 
 static void
@@ -402,11 +1156,27 @@ static void
   
 	phone.start_time = time(0);
 	phone.first_key = phone.current_key = 0;
-	web.start_time = 0;
+	web.start_time = web_failed_start = 0;
 	web.first_key = web.current_key = 0;
+	phone.done = web.done = 0;
+	key_ranges_drop_below(&acked, ikey + 1);
+	if (cfg_newest_first) start_newest_first(ikey);
+	offline = false;
+	cancel_staging();
+	cancel_retry();
+	send_failures = 0;
+	gave_up = false;
+	cancel_prefetch();
 	minute_index = 0;
-	minute_data_size = 0;
-	minute_last = ikey ? (ikey + 1) * 60 : 0;
+	page->size = 0;
+	page->last = ikey ? (ikey + 1) * 60 : 0;
+	/* a message still in flight from before fails back to the start */
+	in_flight_key = cfg_newest_first ? window_first / 60 : page->last / 60;
+	in_flight_minutes = 0;
+	page_loads = page_stalls = 0;
+	rollup_reset(&rollup, cfg_csv_lines ? 1 : cfg_resolution);
+	perf_reset();
+	page_stall_ms = 0;
 	set_modal_mode(false);
 }
 
@@ -427,6 +1197,18 @@ handle_last_sent(Tuple *tuple) {
 		return;
 	}
 	APP_LOG(APP_LOG_LEVEL_INFO, "received LAST_SENT %" PRIu32, ikey);
+
+	if (tuple->type == TUPLE_CSTRING && ikey < checkpoint_key) {
+		/* explicitly lowered, to export the minutes after it again */
+		reset_checkpoint(ikey);
+	} else if (tuple->type == TUPLE_CSTRING) {
+		advance_checkpoint(ikey);
+	} else if (checkpoint_key > ikey) {
+		/* the phone lost track of minutes already uploaded */
+		APP_LOG(APP_LOG_LEVEL_INFO,
+		    "resuming from checkpoint %" PRIu32, checkpoint_key);
+		ikey = checkpoint_key;
+	}
   setup_last_sent(ikey);
 }
 
@@ -452,9 +1234,13 @@ handle_received_tuple(Tuple *tuple) {
 		// APP_LOG(APP_LOG_LEVEL_INFO, "MESSAGE_KEY_uploadDone");
     web.current_key = tuple_uint(tuple);
 		if (!web.first_key) web.first_key = web.current_key;
-		display_dirty = true;
-		if (auto_close && !sending_data
-		    && web.current_key >= phone.current_key)
+		resume_web_rate();
+		/* the range starts at uploadFirst, read along with it */
+		ack_range(upload_first ? upload_first : checkpoint_key + 1,
+		    web.current_key);
+		save_checkpoint(false);
+		schedule_redraw();
+		if (auto_close && !sending_data && web.done >= phone.done)
 			close_app();
     return;
   }
@@ -464,34 +1250,73 @@ handle_received_tuple(Tuple *tuple) {
 		if (!web.first_key) {
 			web.first_key = tuple_uint(tuple);
 			web.start_time = time(0);
+		} else {
+			resume_web_rate();
 		}
     return;
    }
 
   if (tuple->key == MESSAGE_KEY_resend) {
     APP_LOG(APP_LOG_LEVEL_INFO, "MESSAGE_KEY_resend");
+    reset_checkpoint(0);
     setup_last_sent(0);
+    resend_echo = true;
+    resend_echo_in_flight = false;
     return;
   }
   
   if (tuple->key == MESSAGE_KEY_uploadFailed) {
     APP_LOG(APP_LOG_LEVEL_INFO, "MESSAGE_KEY_uploadFailed");
+		/* put the start aside while the failure is displayed */
+		if (web.start_time) web_failed_start = web.start_time;
 		web.start_time = 0;
 		if (tuple->type == TUPLE_CSTRING)
 			snprintf(web.rate, sizeof web.rate,
 			    "%s", tuple->value->cstring);
+		schedule_redraw();
     return;
   }
 
 	if (tuple->key == MESSAGE_KEY_cfgAutoClose) {
 		auto_close = cfg_auto_close = (tuple_uint(tuple) != 0);
 		persist_write_bool(MESSAGE_KEY_cfgAutoClose, auto_close);
-		if (auto_close && !sending_data
-		    && web.current_key >= phone.current_key)
+		if (auto_close && !sending_data && web.done >= phone.done)
 			close_app();
     return;
   }
 
+	if (tuple->key == MESSAGE_KEY_uploadFirst) {
+		/* read with MESSAGE_KEY_uploadDone */
+		return;
+	}
+
+	if (tuple->key == MESSAGE_KEY_cfgExportOrder) {
+		/* used from the next export on */
+		cfg_newest_first = (tuple->type == TUPLE_CSTRING)
+		    ? !strcmp(tuple->value->cstring, "newest")
+		    : (tuple_uint(tuple) != 0);
+		persist_write_bool(MESSAGE_KEY_cfgExportOrder,
+		    cfg_newest_first);
+		return;
+	}
+
+	if (tuple->key == MESSAGE_KEY_cfgUploadWindow
+	    || tuple->key == MESSAGE_KEY_cfgFlushDelay
+	    || tuple->key == MESSAGE_KEY_cfgUploadFormat
+	    || tuple->key == MESSAGE_KEY_cfgEndpointRuns
+	    || tuple->key == MESSAGE_KEY_cfgStatsEndpoint
+	    || tuple->key == MESSAGE_KEY_cfgUploadCompression
+	    || tuple->key == MESSAGE_KEY_cfgHighWaterEndpoint) {
+		/* only used by the phone */
+		return;
+	}
+
+	if (tuple->key == MESSAGE_KEY_cfgCsvLines) {
+		cfg_csv_lines = (tuple_uint(tuple) != 0);
+		persist_write_bool(MESSAGE_KEY_cfgCsvLines, cfg_csv_lines);
+		return;
+	}
+
 	 if (tuple->key == MESSAGE_KEY_cfgWakeupTime) {
 		cfg_wakeup_time = tuple_int(tuple);
 		persist_write_int(MESSAGE_KEY_cfgWakeupTime, cfg_wakeup_time + 1);
@@ -499,6 +1324,35 @@ handle_received_tuple(Tuple *tuple) {
 		    "wrote cfg_wakeup_time %i", cfg_wakeup_time);
     return;
    }
+
+	if (tuple->key == MESSAGE_KEY_cfgResolution) {
+		/* used from the next export on */
+		cfg_resolution = (tuple->type == TUPLE_CSTRING)
+		    ? (uint32_t)atoi(tuple->value->cstring) : tuple_uint(tuple);
+		if (!cfg_resolution || cfg_resolution > 60) cfg_resolution = 1;
+		persist_write_int(MESSAGE_KEY_cfgResolution, cfg_resolution);
+		return;
+	}
+
+	if (tuple->key == MESSAGE_KEY_cfgBackgroundCollect) {
+		/* the worker is started or stopped when the app exits */
+		cfg_background_collect = (tuple_uint(tuple) != 0);
+		persist_write_bool(MESSAGE_KEY_cfgBackgroundCollect,
+		    cfg_background_collect);
+		return;
+	}
+
+	if (tuple->key == MESSAGE_KEY_cfgRetryBudget) {
+		if (tuple_int(tuple) >= 0) cfg_retry_budget = tuple_int(tuple);
+		persist_write_int(MESSAGE_KEY_cfgRetryBudget, cfg_retry_budget);
+		return;
+	}
+
+	if (tuple->key == MESSAGE_KEY_cfgFrameBudget) {
+		if (tuple_int(tuple) > 0) cfg_frame_budget = tuple_int(tuple);
+		persist_write_int(MESSAGE_KEY_cfgFrameBudget, cfg_frame_budget);
+		return;
+	}
   
 	 if (tuple->key == MESSAGE_KEY_cfgAuthToken) {
 		cfg_auth_token = tuple->value->cstring;
@@ -524,8 +1378,8 @@ handle_received_tuple(Tuple *tuple) {
    }
   
 		APP_LOG(APP_LOG_LEVEL_ERROR,
-		    "Unknown key %lu in received message, value : %s",
-		    (unsigned long)tuple->key, tuple->value);
+		    "Unknown key %lu in received message, type %d",
+		    (unsigned long)tuple->key, (int)tuple->type);
 }
 
 static void
@@ -533,6 +1387,9 @@ inbox_received_handler(DictionaryIterator *iterator, void *context) {
 	Tuple *tuple;
 	(void)context;
 
+	tuple = dict_find(iterator, MESSAGE_KEY_uploadFirst);
+	upload_first = tuple ? tuple_uint(tuple) : 0;
+
 	for (tuple = dict_read_first(iterator);
 	    tuple;
 	    tuple = dict_read_next(iterator))
@@ -549,6 +1406,14 @@ static void
 outbox_sent_handler(DictionaryIterator *iterator, void *context) {
 	(void)iterator;
 	(void)context;
+	perf_record(PERF_OUTBOX, outbox_send_time);
+	send_failures = 0;
+	if (staged_in_flight) {
+		staged_in_flight = false;
+		persist_ring_pop(&ring);
+	}
+	if (resend_echo_in_flight)
+		resend_echo = resend_echo_in_flight = false;
 	send_next_line();
 }
 
@@ -558,27 +1423,92 @@ outbox_failed_handler(DictionaryIterator *iterator, AppMessageResult reason,
 	(void)iterator;
 	(void)context;
 	APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox failed: 0x%x", (unsigned)reason);
+	perf_stats.outbox_failures += 1;
+	send_failed(reason);
+}
+
+/* take_ring - load the staged blocks, once the worker left them */
+static void
+take_ring(void) {
+	persist_ring_load(&ring);
+	ring_owned = true;
+	APP_LOG(APP_LOG_LEVEL_INFO,
+	    "%u staged blocks from %" PRIi32 " to %" PRIi32,
+	    (unsigned)ring.count, ring.first_key, ring.next_key);
 }
 
+/* release_ring - record where the worker should resume and hand the */
+/*    ring over to it, starting or stopping it per the settings */
 static void
-tick_handler(struct tm *tick_time, TimeUnits units_changed) {
-	(void)tick_time;
-	(void)units_changed;
-	if (display_dirty) update_progress();
+release_ring(void) {
+	int32_t sent_key = (phone.current_key && !cfg_newest_first)
+	    ? (int32_t)phone.current_key : (int32_t)checkpoint_key;
+	AppWorkerMessage message = { 0 };
+
+	if (ring_owned && sent_key > 0) {
+		while (ring.count > 0 && ring.first_key <= sent_key)
+			persist_ring_pop(&ring);
+		if (!ring.count) ring.next_key = sent_key + 1;
+		persist_ring_save(&ring);
+	}
+	ring_owned = false;
+
+	if (!cfg_background_collect) {
+		if (app_worker_is_running()) app_worker_kill();
+	} else if (app_worker_is_running()) {
+		app_worker_send_message(WORKER_MSG_UNLOCK, &message);
+	} else {
+		app_worker_launch();
+	}
+}
+
+static void
+worker_message_handler(uint16_t type, AppWorkerMessage *message) {
+	(void)message;
+	if (type == WORKER_MSG_LOCKED && !ring_owned) take_ring();
 }
 
 static void
 init(void) {
+	uint32_t inbox_size;
+
 	APP_LOG(APP_LOG_LEVEL_INFO, "init starting");
 	cfg_auto_close = persist_read_bool(MESSAGE_KEY_cfgAutoClose);
+	cfg_csv_lines = persist_read_bool(MESSAGE_KEY_cfgCsvLines);
 	cfg_wakeup_time = persist_read_int(MESSAGE_KEY_cfgWakeupTime) - 1;
+	cfg_resolution = persist_read_int(MESSAGE_KEY_cfgResolution);
+	if (!cfg_resolution || cfg_resolution > 60) cfg_resolution = 1;
+	if (persist_read_int(MESSAGE_KEY_cfgFrameBudget) > 0)
+		cfg_frame_budget = persist_read_int(MESSAGE_KEY_cfgFrameBudget);
 	auto_close = (cfg_auto_close || launch_reason() == APP_LAUNCH_WAKEUP);
-  last_key = persist_read_int(MESSAGE_KEY_lastSent);
+	checkpoint_key = checkpoint_saved = persist_read_int(MESSAGE_KEY_lastSent);
+	cfg_background_collect
+	    = persist_read_bool(MESSAGE_KEY_cfgBackgroundCollect);
+	cfg_newest_first = persist_read_bool(MESSAGE_KEY_cfgExportOrder);
+	if (persist_exists(MESSAGE_KEY_cfgRetryBudget))
+		cfg_retry_budget = persist_read_int(MESSAGE_KEY_cfgRetryBudget);
+	key_ranges_load(&acked, MESSAGE_KEY_uploadDone);
+
+	connection_service_subscribe((ConnectionHandlers) {
+	    .pebble_app_connection_handler = &connection_handler,
+	});
+	app_worker_message_subscribe(&worker_message_handler);
+	if (app_worker_is_running()) {
+		AppWorkerMessage message = { 0 };
+		app_worker_send_message(WORKER_MSG_LOCK, &message);
+	} else {
+		take_ring();
+	}
   
 	app_message_register_inbox_received(inbox_received_handler);
 	app_message_register_outbox_failed(outbox_failed_handler);
 	app_message_register_outbox_sent(outbox_sent_handler);
-	app_message_open(256, 2048);
+	outbox_size = app_message_outbox_size_maximum();
+	if (outbox_size > OUTBOX_SIZE_LIMIT) outbox_size = OUTBOX_SIZE_LIMIT;
+	inbox_size = INBOX_SIZE;
+	if (inbox_size > app_message_inbox_size_maximum())
+		inbox_size = app_message_inbox_size_maximum();
+	app_message_open(inbox_size, outbox_size);
 
 	strncpy(modal_text, "Waiting for JS part", sizeof modal_text);
 	window = window_create();
@@ -586,14 +1516,16 @@ init(void) {
 	    .load = window_load,
 	    .unload = window_unload,
 	});
+	window_set_click_config_provider(window, &click_config_provider);
 	window_stack_push(window, true);
-	tick_timer_service_subscribe(SECOND_UNIT, &tick_handler);
 	wakeup_cancel_all();
 	APP_LOG(APP_LOG_LEVEL_INFO, "init complete");
 }
 
 static void deinit(void) {
 	APP_LOG(APP_LOG_LEVEL_INFO, "deinit starting"); 
+	save_checkpoint(true);
+	release_ring();
 	window_destroy(window);
 
 	if (cfg_wakeup_time > 0) {
@@ -605,7 +1537,7 @@ static void deinit(void) {
 			APP_LOG(APP_LOG_LEVEL_ERROR,
 			    "wakeup_schedule(%" PRIi32 ", 0, true)"
 			    " returned %" PRIi32,
-			    wakeup_time, res);
+			    (int32_t)wakeup_time, res);
 	} else {
 		APP_LOG(APP_LOG_LEVEL_INFO, "No wakeup to setup");
 	}
@@ -617,4 +1549,5 @@ main(void) {
 	init();
 	app_event_loop();
 	deinit();
+	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+
+#include "perf_stats.h"
+
+struct perf_stats perf_stats;
+
+static const char *stage_name[PERF_STAGE_COUNT] = {
+	"health",
+	"activity",
+	"encode",
+	"outbox",
+};
+
+void
+perf_reset(void) {
+	memset(&perf_stats, 0, sizeof perf_stats);
+}
+
+/* perf_clock - millisecond clock, only meaningful for differences */
+uint32_t
+perf_clock(void) {
+	time_t s;
+	uint16_t ms;
+
+	time_ms(&s, &ms);
+	return (uint32_t)s * 1000 + ms;
+}
+
+/* perf_record - account the time of a stage started at perf_clock start */
+void
+perf_record(enum perf_stage stage, uint32_t start) {
+	struct perf_histogram *histogram = perf_stats.stage + stage;
+	uint32_t duration = perf_clock() - start;
+	unsigned n = 0;
+
+	while (n + 1 < PERF_BUCKET_COUNT && duration >= (1u << n)) n += 1;
+
+	histogram->count += 1;
+	histogram->total_ms += duration;
+	if (duration > histogram->max_ms) histogram->max_ms = duration;
+	if (histogram->bucket[n] < UINT16_MAX) histogram->bucket[n] += 1;
+}
+
+/* perf_percentile - upper bound of the bucket holding the percentile */
+/*    in ms, at most the maximum seen */
+uint32_t
+perf_percentile(enum perf_stage stage, unsigned percent) {
+	const struct perf_histogram *histogram = perf_stats.stage + stage;
+	uint32_t target = (histogram->count * percent + 99) / 100;
+	uint32_t seen = 0;
+	unsigned n;
+
+	for (n = 0; n < PERF_BUCKET_COUNT; n++) {
+		seen += histogram->bucket[n];
+		if (seen >= target && seen > 0) break;
+	}
+
+	if (n >= PERF_BUCKET_COUNT - 1 || histogram->max_ms < (1u << n))
+		return histogram->max_ms;
+	return (1u << n) - 1;
+}
+
+/* perf_format - one line per stage: count, average, p90 and max in ms */
+size_t
+perf_format(char *buffer, size_t size) {
+	size_t used = 0;
+	int ret;
+
+	for (unsigned i = 0; i < PERF_STAGE_COUNT && used < size; i++) {
+		const struct perf_histogram *histogram = perf_stats.stage + i;
+		ret = snprintf(buffer + used, size - used,
+		    "%s %" PRIu32 "x\n %" PRIu32 "/%" PRIu32 "/%" PRIu32 " ms\n",
+		    stage_name[i], histogram->count,
+		    histogram->count ? histogram->total_ms / histogram->count : 0,
+		    perf_percentile(i, 90), histogram->max_ms);
+		if (ret < 0) break;
+		used += ret;
+	}
+
+	if (used < size) {
+		ret = snprintf(buffer + used, size - used,
+		    "failed %" PRIu32 ", %" PRIu32 " kB",
+		    perf_stats.outbox_failures,
+		    perf_stats.outbox_bytes / 1024);
+		if (ret > 0) used += ret;
+	}
+
+	return used < size ? used : size - 1;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <pebble.h>
+
+/* timed stages of the export */
+enum perf_stage {
+	PERF_HISTORY,		/* health_service_get_minute_history */
+	PERF_ACTIVITIES,	/* health_service_activities_iterate */
+	PERF_ENCODE,		/* filling an outbox message */
+	PERF_OUTBOX,		/* outbox send until acknowledged */
+	PERF_STAGE_COUNT
+};
+
+/* bucket n counts durations in [2^(n-1), 2^n) ms, bucket 0 under 1 ms */
+#define PERF_BUCKET_COUNT 12
+
+struct perf_histogram {
+	uint32_t	count;
+	uint32_t	total_ms;
+	uint32_t	max_ms;
+	uint16_t	bucket[PERF_BUCKET_COUNT];
+};
+
+struct perf_stats {
+	struct perf_histogram stage[PERF_STAGE_COUNT];
+	uint32_t	outbox_failures;
+	uint32_t	outbox_bytes;
+};
+
+extern struct perf_stats perf_stats;
+
+void
+perf_reset(void);
+
+uint32_t
+perf_clock(void);
+
+void
+perf_record(enum perf_stage stage, uint32_t start);
+
+uint32_t
+perf_percentile(enum perf_stage stage, unsigned percent);
+
+size_t
+perf_format(char *buffer, size_t size);
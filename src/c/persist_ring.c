@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "persist_ring.h"
+#include "wire_format.h"
+
+#define PERSIST_RING_VERSION	1
+
+/* stored layout of the cursors */
+struct persist_ring_meta {
+	uint8_t		version;
+	uint8_t		head;
+	uint8_t		count;
+	uint8_t		reserved;
+	int32_t		next_key;
+};
+
+static uint32_t
+slot_key(uint8_t slot) {
+	return PERSIST_RING_KEY_BASE + 1 + slot % PERSIST_RING_CHUNK_COUNT;
+}
+
+/* update_first_key - read the base key of the oldest block */
+static void
+update_first_key(struct persist_ring *ring) {
+	uint8_t header[WIRE_HEADER_SIZE];
+
+	ring->first_key = 0;
+	if (!ring->count) return;
+
+	if (persist_read_data(slot_key(ring->head), header, sizeof header)
+	    == (int)sizeof header) {
+		ring->first_key = wire_get_i32(header + 4);
+	} else {
+		APP_LOG(APP_LOG_LEVEL_ERROR,
+		    "persist_ring: missing block in slot %u, dropping the ring",
+		    (unsigned)ring->head);
+		persist_ring_clear(ring);
+	}
+}
+
+/* persist_ring_load - restore the cursors, an empty ring if none */
+void
+persist_ring_load(struct persist_ring *ring) {
+	struct persist_ring_meta meta;
+
+	if (persist_read_data(PERSIST_RING_KEY_BASE, &meta, sizeof meta)
+	    != (int)sizeof meta
+	    || meta.version != PERSIST_RING_VERSION
+	    || meta.count > PERSIST_RING_CHUNK_COUNT) {
+		meta.head = meta.count = 0;
+		meta.next_key = 0;
+	}
+
+	ring->head = meta.head % PERSIST_RING_CHUNK_COUNT;
+	ring->count = meta.count;
+	ring->next_key = meta.next_key;
+	update_first_key(ring);
+}
+
+/* persist_ring_save - write the cursors */
+void
+persist_ring_save(const struct persist_ring *ring) {
+	struct persist_ring_meta meta = {
+		.version = PERSIST_RING_VERSION,
+		.head = ring->head,
+		.count = ring->count,
+		.next_key = ring->next_key,
+	};
+
+	persist_write_data(PERSIST_RING_KEY_BASE, &meta, sizeof meta);
+}
+
+/* persist_ring_push - append a block ending before next_key */
+/*    evicting the oldest blocks to make room if allowed */
+/*    returns false when the block could not be stored */
+bool
+persist_ring_push(struct persist_ring *ring, const uint8_t *block,
+    size_t size, int32_t next_key, bool evict) {
+	if (size > PERSIST_RING_CHUNK_SIZE) return false;
+
+	if (ring->count >= PERSIST_RING_CHUNK_COUNT) {
+		if (!evict) return false;
+		persist_ring_pop(ring);
+	}
+
+	while (persist_write_data(slot_key(ring->head + ring->count),
+	    block, size) != (int)size) {
+		/* out of storage */
+		if (!evict || !ring->count) return false;
+		persist_ring_pop(ring);
+	}
+
+	if (!ring->count) ring->first_key = wire_get_i32(block + 4);
+	ring->count += 1;
+	ring->next_key = next_key;
+	persist_ring_save(ring);
+	return true;
+}
+
+/* persist_ring_peek - copy the oldest block into buffer */
+/*    returns its size, 0 when the ring is empty */
+size_t
+persist_ring_peek(const struct persist_ring *ring, uint8_t *buffer,
+    size_t size) {
+	int result;
+
+	if (!ring->count) return 0;
+	result = persist_read_data(slot_key(ring->head), buffer, size);
+	return result > WIRE_HEADER_SIZE ? (size_t)result : 0;
+}
+
+/* persist_ring_pop - drop the oldest block */
+void
+persist_ring_pop(struct persist_ring *ring) {
+	if (!ring->count) return;
+
+	persist_delete(slot_key(ring->head));
+	ring->head = (ring->head + 1) % PERSIST_RING_CHUNK_COUNT;
+	ring->count -= 1;
+	persist_ring_save(ring);
+	update_first_key(ring);
+}
+
+/* persist_ring_clear - drop every block, keeping next_key */
+void
+persist_ring_clear(struct persist_ring *ring) {
+	for (uint8_t i = 0; i < ring->count; i++)
+		persist_delete(slot_key(ring->head + i));
+	ring->head = ring->count = 0;
+	ring->first_key = 0;
+	persist_ring_save(ring);
+}
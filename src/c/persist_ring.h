@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Ring of encoded wire format blocks in persistent storage, shared
+ * between the background worker, which stages the minutes it collects,
+ * and the app, which sends and pops them.
+ *
+ * Each block is a persist_write_data entry of at most
+ * PERSIST_RING_CHUNK_SIZE bytes, under PERSIST_RING_KEY_BASE + 1 + slot
+ * for PERSIST_RING_CHUNK_COUNT slots, and the cursors are kept under
+ * PERSIST_RING_KEY_BASE. The blocks hold consecutive minutes, up to
+ * next_key excluded.
+ *
+ * The ring is filled by the worker in the background and by the app while
+ * the phone is disconnected. When a push with evict finds the ring full,
+ * or persistent storage out of room, the oldest blocks are dropped first:
+ * they cover the earliest minutes, which the next export reads again from
+ * the health history instead.
+ *
+ * Only one side may write the ring at a time: the app sends
+ * WORKER_MSG_LOCK to a running worker and takes the ring over once it
+ * receives WORKER_MSG_LOCKED, then hands it back with WORKER_MSG_UNLOCK
+ * before exiting.
+ */
+
+#pragma once
+
+#include "platform.h"
+
+#define PERSIST_RING_KEY_BASE	0x1000
+#define PERSIST_RING_CHUNK_COUNT	8
+#define PERSIST_RING_CHUNK_SIZE	PERSIST_DATA_MAX_LENGTH
+
+/* AppWorkerMessage types of the handoff protocol */
+#define WORKER_MSG_LOCK		1
+#define WORKER_MSG_LOCKED	2
+#define WORKER_MSG_UNLOCK	3
+
+struct persist_ring {
+	uint8_t		head;		/* slot of the oldest block */
+	uint8_t		count;		/* number of blocks */
+	int32_t		next_key;	/* first minute not staged, 0 if unknown */
+	int32_t		first_key;	/* first minute of the oldest block */
+};
+
+void
+persist_ring_load(struct persist_ring *ring);
+
+void
+persist_ring_save(const struct persist_ring *ring);
+
+bool
+persist_ring_push(struct persist_ring *ring, const uint8_t *block,
+    size_t size, int32_t next_key, bool evict);
+
+size_t
+persist_ring_peek(const struct persist_ring *ring, uint8_t *buffer,
+    size_t size);
+
+void
+persist_ring_pop(struct persist_ring *ring);
+
+void
+persist_ring_clear(struct persist_ring *ring);
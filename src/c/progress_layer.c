@@ -86,6 +86,7 @@ void progress_layer_increment_progress(ProgressLayer* progress_layer, int16_t pr
 
 void progress_layer_set_progress(ProgressLayer* progress_layer, int16_t progress_percent) {
   ProgressLayerData *data = (ProgressLayerData *)layer_get_data(progress_layer);
+  if (data->progress_percent == MIN(100, progress_percent)) return;
   data->progress_percent = MIN(100, progress_percent);
   layer_mark_dirty(progress_layer);
 }
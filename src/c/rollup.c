@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "rollup.h"
+#include "wire_format.h"
+
+/* bucket_key - first minute of the bucket holding a key */
+static int32_t
+bucket_key(int32_t key, uint8_t resolution) {
+	int32_t offset = key % resolution;
+	return key - (offset < 0 ? offset + resolution : offset);
+}
+
+/* rollup_reset - start an empty bucket of the given resolution */
+void
+rollup_reset(struct rollup *rollup, uint8_t resolution) {
+	memset(rollup, 0, sizeof *rollup);
+	rollup->resolution = resolution ? resolution : 1;
+	rollup->empty = true;
+}
+
+/* rollup_accepts - whether a minute belongs to the current bucket */
+bool
+rollup_accepts(const struct rollup *rollup, int32_t key) {
+	return rollup->empty
+	    || bucket_key(key, rollup->resolution) == rollup->key;
+}
+
+/* rollup_add - account a minute, which rollup_accepts */
+void
+rollup_add(struct rollup *rollup, int32_t key, const HealthMinuteData *data,
+    HealthActivityMask activity_mask) {
+	if (rollup->empty) {
+		rollup->key = bucket_key(key, rollup->resolution);
+		rollup->empty = false;
+	}
+
+	rollup->activity |= activity_mask;
+	if (data->is_invalid) return;
+
+	rollup->valid += 1;
+	rollup->steps += data->steps;
+	rollup->vmc_sum += data->vmc;
+	if (data->vmc > rollup->vmc_max) rollup->vmc_max = data->vmc;
+	if (data->light > rollup->light) rollup->light = data->light;
+
+	if (data->heart_rate_bpm) {
+		if (!rollup->hr_count || data->heart_rate_bpm < rollup->hr_min)
+			rollup->hr_min = data->heart_rate_bpm;
+		if (data->heart_rate_bpm > rollup->hr_max)
+			rollup->hr_max = data->heart_rate_bpm;
+		rollup->hr_sum += data->heart_rate_bpm;
+		rollup->hr_count += 1;
+	}
+}
+
+/* rollup_last_key - last minute of the current bucket */
+int32_t
+rollup_last_key(const struct rollup *rollup) {
+	return rollup->key + rollup->resolution - 1;
+}
+
+/* rollup_record - fill WIRE_ROLLUP_SIZE bytes with the current bucket */
+void
+rollup_record(const struct rollup *rollup, uint8_t *buffer,
+    uint8_t key_delta) {
+	buffer[0] = key_delta;
+	buffer[1] = rollup->resolution - rollup->valid;
+	wire_put_u16(buffer + 2, rollup->steps);
+	wire_put_u32(buffer + 4, rollup->vmc_sum);
+	wire_put_u16(buffer + 8, rollup->vmc_max);
+	buffer[10] = rollup->hr_min;
+	buffer[11] = rollup->hr_count
+	    ? (rollup->hr_sum + rollup->hr_count / 2) / rollup->hr_count : 0;
+	buffer[12] = rollup->hr_max;
+	buffer[13] = rollup->activity;
+	buffer[14] = rollup->light;
+	buffer[15] = 0;
+}
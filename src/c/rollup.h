@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <pebble.h>
+
+/* aggregate of the minutes of a bucket, see WIRE_TYPE_ROLLUP */
+struct rollup {
+	int32_t		key;		/* first minute of the bucket */
+	uint8_t		resolution;	/* minutes per bucket */
+	uint8_t		valid;
+	uint8_t		hr_count;
+	uint8_t		hr_min;
+	uint8_t		hr_max;
+	uint8_t		activity;
+	uint8_t		light;
+	uint16_t	steps;
+	uint16_t	vmc_max;
+	uint16_t	hr_sum;
+	uint32_t	vmc_sum;
+	bool		empty;
+};
+
+void
+rollup_reset(struct rollup *rollup, uint8_t resolution);
+
+bool
+rollup_accepts(const struct rollup *rollup, int32_t key);
+
+void
+rollup_add(struct rollup *rollup, int32_t key, const HealthMinuteData *data,
+    HealthActivityMask activity_mask);
+
+int32_t
+rollup_last_key(const struct rollup *rollup);
+
+void
+rollup_record(const struct rollup *rollup, uint8_t *buffer,
+    uint8_t key_delta);
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+
+#include "text_format.h"
+
+static uint8_t
+days_in_month(int16_t year, uint8_t month) {
+	static const uint8_t days[12] =
+	    { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+	if (month == 2 && year % 4 == 0
+	    && (year % 100 != 0 || year % 400 == 0))
+		return 29;
+	return days[month - 1];
+}
+
+/* utc_clock_sync - reset the clock from gmtime */
+static bool
+utc_clock_sync(struct utc_clock *clock, time_t key) {
+	struct tm *tm = gmtime(&key);
+
+	if (!tm) {
+		APP_LOG(APP_LOG_LEVEL_ERROR,
+		    "Unable to get UTC time for %" PRIi32, (int32_t)key);
+		clock->valid = false;
+		return false;
+	}
+
+	clock->key = key;
+	clock->year = tm->tm_year + 1900;
+	clock->month = tm->tm_mon + 1;
+	clock->day = tm->tm_mday;
+	clock->hour = tm->tm_hour;
+	clock->minute = tm->tm_min;
+	clock->second = tm->tm_sec;
+	clock->valid = true;
+	return true;
+}
+
+/* utc_clock_advance - move the clock one minute forward, carrying by hand */
+static void
+utc_clock_advance(struct utc_clock *clock) {
+	clock->key += 60;
+	if (++clock->minute < 60) return;
+	clock->minute = 0;
+	if (++clock->hour < 24) return;
+	clock->hour = 0;
+	if (++clock->day <= days_in_month(clock->year, clock->month)) return;
+	clock->day = 1;
+	if (++clock->month <= 12) return;
+	clock->month = 1;
+	clock->year += 1;
+}
+
+static char *
+format_2digits(char *buffer, uint8_t value) {
+	buffer[0] = '0' + value / 10;
+	buffer[1] = '0' + value % 10;
+	return buffer + 2;
+}
+
+/* utc_clock_format - write the RFC-3339 representation of key */
+/*    consecutive minutes only advance the broken-down time of the previous */
+/*    call, gmtime is used for other keys; returns UTC_CLOCK_LENGTH, or 0 */
+/*    on failure, and always NUL-terminates a successful result */
+size_t
+utc_clock_format(struct utc_clock *clock, char *buffer, time_t key) {
+	char *p = buffer;
+
+	if (clock->valid && key == clock->key + 60) {
+		utc_clock_advance(clock);
+	} else if (!clock->valid || key != clock->key) {
+		if (!utc_clock_sync(clock, key)) return 0;
+	}
+
+	if (clock->year < 0 || clock->year > 9999) {
+		APP_LOG(APP_LOG_LEVEL_ERROR,
+		    "Year %d out of RFC-3339 range", (int)clock->year);
+		return 0;
+	}
+
+	p = format_2digits(p, clock->year / 100);
+	p = format_2digits(p, clock->year % 100);
+	*p++ = '-';
+	p = format_2digits(p, clock->month);
+	*p++ = '-';
+	p = format_2digits(p, clock->day);
+	*p++ = 'T';
+	p = format_2digits(p, clock->hour);
+	*p++ = ':';
+	p = format_2digits(p, clock->minute);
+	*p++ = ':';
+	p = format_2digits(p, clock->second);
+	*p++ = 'Z';
+	*p = 0;
+
+	return p - buffer;
+}
+
+/* format_uint - write the decimal representation of value */
+/*    returns a pointer past the last digit, without terminating the string */
+char *
+format_uint(char *buffer, uint32_t value) {
+	char digits[10];
+	uint8_t n = 0;
+
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	while (n) *buffer++ = digits[--n];
+	return buffer;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Encoder of WIRE_TYPE_MINUTE blocks, shared by the app and the worker */
+
+#include "wire_encoder.h"
+#include "wire_format.h"
+
+/* minute_data_record - fill WIRE_RECORD_SIZE bytes with binary data */
+static void
+minute_data_record(uint8_t *buffer, const HealthMinuteData *data,
+    HealthActivityMask activity_mask, uint8_t key_delta) {
+	buffer[0] = key_delta;
+	buffer[6] = activity_mask;
+
+	if (data->is_invalid) {
+		buffer[1] = buffer[2] = buffer[7] = 0;
+		buffer[3] = WIRE_FLAG_INVALID;
+		wire_put_u16(buffer + 4, 0);
+		return;
+	}
+
+	buffer[1] = data->steps;
+	buffer[2] = data->orientation;
+	buffer[3] = data->light & WIRE_FLAG_LIGHT_MASK;
+	wire_put_u16(buffer + 4, data->vmc);
+	buffer[7] = data->heart_rate_bpm;
+}
+
+/* minute_record_idle - whether a binary record can start a run */
+static bool
+minute_record_idle(const uint8_t *record) {
+	return (record[3] & WIRE_FLAG_INVALID)
+	    || (record[1] == 0 && wire_get_u16(record + 4) == 0);
+}
+
+/* wire_encode_minutes - fill buffer with a block of the minutes */
+/*    [first, last) of data, minute i having key base_key + i and the */
+/*    activities of index at i, collapsing runs of idle minutes */
+/*    returns the block size, 0 when empty, and the first minute left */
+/*    out in *end */
+size_t
+wire_encode_minutes(uint8_t *buffer, size_t capacity,
+    const HealthMinuteData *data, struct activity_index *activity,
+    uint16_t first, uint16_t last, int32_t base_key, uint16_t *end) {
+	size_t used = WIRE_HEADER_SIZE;
+	uint16_t index = first;
+	uint8_t count = 0;
+
+	while (index < last
+	    && count < WIRE_RECORD_COUNT_MAX
+	    && used + WIRE_RECORD_SIZE <= capacity) {
+		uint8_t *record = buffer + used;
+		uint16_t run = 1;
+
+		minute_data_record(record, data + index,
+		    activity_index_mask(activity, index),
+		    count ? 1 : 0);
+
+		if (minute_record_idle(record)) {
+			uint8_t next[WIRE_RECORD_SIZE];
+			while (index + run < last && run < UINT16_MAX) {
+				minute_data_record(next, data + index + run,
+				    activity_index_mask(activity, index + run),
+				    1);
+				if (memcmp(next + 1, record + 1,
+				    WIRE_RECORD_SIZE - 1)) break;
+				run += 1;
+			}
+		}
+
+		if (run > 1) {
+			record[3] |= WIRE_FLAG_RUN;
+			wire_put_u16(record + 4, run);
+		}
+
+		used += WIRE_RECORD_SIZE;
+		index += run;
+		count += 1;
+	}
+
+	*end = index;
+	if (!count) return 0;
+	wire_put_header(buffer, WIRE_TYPE_MINUTE, 1, count, base_key + first);
+	return used;
+}
+
+/* wire_block_last_key - key of the last minute of a WIRE_TYPE_MINUTE block */
+int32_t
+wire_block_last_key(const uint8_t *block) {
+	int32_t key = wire_get_i32(block + 4);
+	const uint8_t *record = block + WIRE_HEADER_SIZE;
+
+	for (uint8_t i = 0; i < block[3]; i++, record += WIRE_RECORD_SIZE) {
+		key += record[0];
+		if (record[3] & WIRE_FLAG_RUN)
+			key += wire_get_u16(record + 4) - 1;
+	}
+
+	return key;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Binary wire format of the minute records, sent from the watch to the
+ * phone as a byte array under MESSAGE_KEY_dataBinary, and decoded by
+ * src/pkjs/wire_format.js. All multi-byte integers are little-endian.
+ *
+ * Header:
+ *   0  version       WIRE_FORMAT_VERSION
+ *   1  record type   WIRE_TYPE_*
+ *   2  resolution    minutes covered by each record, 1 for raw minutes
+ *   3  record count
+ *   4  base key      int32, minutes since the epoch
+ *
+ * Minute record (WIRE_TYPE_MINUTE):
+ *   0  key delta     minutes since the last minute of the previous record
+ *                    (since the base key for the first record)
+ *   1  steps
+ *   2  orientation   yaw in the low nibble, pitch in the high nibble
+ *   3  flags         ambient light in WIRE_FLAG_LIGHT_MASK, WIRE_FLAG_*
+ *   4  vmc           uint16
+ *   6  activity      HealthActivityMask
+ *   7  heart rate    bpm
+ *
+ * A record with WIRE_FLAG_RUN stands for a run of identical idle minutes
+ * (invalid, or without steps nor vmc): its vmc field holds the number of
+ * minutes in the run instead, and the other fields apply to all of them.
+ * Version 1 blocks are the same without runs.
+ *
+ * Rollup record (WIRE_TYPE_ROLLUP), aggregating the minutes of a bucket
+ * of resolution minutes, aligned on a multiple of resolution keys:
+ *   0  key delta     minutes since the last minute of the previous bucket
+ *                    (since the base key for the first record)
+ *   1  invalid       minutes of the bucket without valid data
+ *   2  steps         uint16, sum
+ *   4  vmc           uint32, sum
+ *   8  vmc max       uint16
+ *  10  heart rate    minimum, average and maximum bpm, 0 without samples
+ *  13  activity      HealthActivityMask, or-ed over the bucket
+ *  14  light         maximum ambient light
+ *  15  reserved      0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define WIRE_FORMAT_VERSION	2
+
+#define WIRE_TYPE_MINUTE	1
+#define WIRE_TYPE_ROLLUP	2
+
+#define WIRE_HEADER_SIZE	8
+#define WIRE_RECORD_SIZE	8
+#define WIRE_ROLLUP_SIZE	16
+#define WIRE_RECORD_COUNT_MAX	255
+
+#define WIRE_FLAG_LIGHT_MASK	0x07
+#define WIRE_FLAG_RUN		0x40
+#define WIRE_FLAG_INVALID	0x80
+
+static inline void
+wire_put_u16(uint8_t *p, uint16_t v) {
+	p[0] = v & 0xFF;
+	p[1] = v >> 8;
+}
+
+static inline void
+wire_put_i32(uint8_t *p, int32_t v) {
+	uint32_t u = (uint32_t)v;
+	p[0] = u & 0xFF;
+	p[1] = (u >> 8) & 0xFF;
+	p[2] = (u >> 16) & 0xFF;
+	p[3] = u >> 24;
+}
+
+static inline void
+wire_put_u32(uint8_t *p, uint32_t v) {
+	wire_put_i32(p, (int32_t)v);
+}
+
+static inline uint16_t
+wire_get_u16(const uint8_t *p) {
+	return p[0] | (uint16_t)p[1] << 8;
+}
+
+static inline int32_t
+wire_get_i32(const uint8_t *p) {
+	return (int32_t)(p[0] | (uint32_t)p[1] << 8
+	    | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+static inline void
+wire_put_header(uint8_t *p, uint8_t type, uint8_t resolution,
+    uint8_t count, int32_t base_key) {
+	p[0] = WIRE_FORMAT_VERSION;
+	p[1] = type;
+	p[2] = resolution;
+	p[3] = count;
+	wire_put_i32(p + 4, base_key);
+}
@@ -17,110 +17,506 @@
 
 var Clay = require('pebble-clay');
 var clayConfig = require('./config.js');
-new Clay(clayConfig);
+var wireFormat = require('./wire_format.js');
+var SendQueue = require('./send_queue.js');
+var BatchSizer = require('./batch_sizer.js');
+var uploadFormat = require('./upload_format.js');
+var PerfStats = require('./perf_stats.js');
+var KeyRanges = require('./key_ranges.js');
+var gzip = require('./gzip.js').gzip;
+var messageKeys = require('message_keys');
+var clay = new Clay(clayConfig, null, { autoHandleEvents: false });
+
+/* settings only read by the phone, left out of the message sent to the */
+/*    watch on closing the configuration page, to fit in its inbox */
+var PHONE_SETTINGS = ["cfgUploadWindow", "cfgFlushDelay", "cfgUploadFormat",
+    "cfgEndpointRuns", "cfgStatsEndpoint", "cfgUploadCompression",
+    "cfgHighWaterEndpoint"];
 
 var cfg_endpoint = null;
 var cfg_bundle_max = 1;
 var cfg_auth_token = "";
 var cfg_auto_close = false;
 var cfg_wakeup_time = -1;
+var cfg_upload_window = 1;
+var cfg_flush_delay = 5;
+var cfg_upload_format = "rows";
+var cfg_endpoint_runs = false;
+var cfg_stats_endpoint = "";
+var cfg_newest_first = false;
+var cfg_compress = false;
+var cfg_high_water_endpoint = "";
+
+/* idle time after which an upload session is considered over */
+var SESSION_IDLE_MS = 30000;
+
+/* failed uploads are retried after a jittered exponential backoff */
+var UPLOAD_TIMEOUT_MS = 30000;
+var RETRY_BASE_MS = 1000;
+var RETRY_MAX_MS = 300000;
+
+/* set when the endpoint refused a compressed body, until the app restarts */
+var compress_rejected = false;
 
-var to_send = [];
-var sender = new XMLHttpRequest();
-var bundle_size = 0;
+var to_send = new SendQueue();
+var last_queued = null;
+var queued_ranges = new KeyRanges();
+var sizer = new BatchSizer(cfg_bundle_max);
+var in_flight = [];
+var dispatched = 0;
+var flush_timer = null;
+var stats = new PerfStats();
+var session_timer = null;
+var retry_timer = null;
+var retry_at = 0;
+var retry_attempts = 0;
+/* set by a client error, which a retry would only repeat */
+var parked = false;
+/* data messages received after Resend, until the watch marks the first */
+/*    one it sent after starting over */
+var resend_held = null;
 var startDate = new Date();
 
 var endDate   = new Date();
 var seconds = (endDate.getTime() - startDate.getTime()) / 1000;
 var sending = false;
 
-function sendPayload(payload) {
-   var payload_array = [];
-   var counter = 0;
-  
-   while (counter < payload.length) {
-     var data = {};
-     var components = payload[counter].split(',');
-     data.timestamp = components[0];
-     data.steps = components[1];
-     data.yaw = components[2];
-     data.pitch = components[3];
-     data.vmc = components[4];
-     data.light = components[5];
-     data.activity = components[6];
-     data.hrbpm = components[7];
-     payload_array.push(data);
-     counter++;
-    }
+function sendPayload(batch, records) {
+   var body = uploadFormat.build(cfg_upload_format, records,
+       cfg_endpoint_runs);
+   var compressed = cfg_compress && !compress_rejected;
+   var sender = new XMLHttpRequest();
+   sender.addEventListener("load", function () {
+      uploadLoaded(batch, sender, compressed);
+   });
+   sender.addEventListener("error", function () { uploadError(batch, sender); });
+   sender.addEventListener("timeout", function () {
+      uploadError(batch, sender);
+   });
+   batch.request = sender;
+   batch.failed = false;
+   batch.raw_bytes = body.length;
+   batch.keys = uploadFormat.keyRange(records);
+   batch.hash = uploadFormat.hash(body);
+   if (compressed) body = gzip(body);
+   batch.bytes = body.length;
+   batch.sent_at = Date.now();
 
    sender.open("POST", cfg_endpoint, true);
+   sender.timeout = UPLOAD_TIMEOUT_MS;
    sender.setRequestHeader("Authorization", "Token token="+cfg_auth_token);
    sender.setRequestHeader("Content-Type", "application/json;charset=UTF-8");
-   sender.send(JSON.stringify(payload_array));
+   sender.setRequestHeader("X-Batch-Keys", batch.keys);
+   sender.setRequestHeader("X-Batch-Hash", batch.hash);
+   if (compressed) sender.setRequestHeader("Content-Encoding", "gzip");
+   sender.send(body);
+}
+
+/* uploadLoaded - sort a response: success, gzip not supported, */
+/*    client error to park, or anything else to retry */
+function uploadLoaded(batch, sender, compressed) {
+   var status = sender.status;
+
+   if (compressed && (status === 415 || status === 400)) {
+      console.log("Endpoint refused gzip (" + status
+          + "), falling back to plain JSON");
+      compress_rejected = true;
+      batch.failed = true;
+      batch.request = null;
+      sendHead();
+      return;
+   }
+   if (status >= 200 && status < 300) {
+      uploadDone(batch);
+   } else if (status >= 400 && status < 500
+       && status !== 408 && status !== 429) {
+      uploadParked(batch, sender);
+   } else {
+      uploadError(batch, sender);
+   }
 }
 
+/* sendBatch - post the records of a batch, from its offset in to_send */
+function sendBatch(batch) {
+  var records = [];
+  for (var i = 0; i < batch.count; i++) {
+     records.push(to_send.get(batch.offset + i));
+  }
+
+  console.log("BundleSize : " + parseInt(batch.count) + " Seconds : " + parseInt(seconds)
+      + " InFlight : " + in_flight.length + " Sizer : " + sizer);
+  sendPayload(batch, records);
+}
+
+/* sendHead - fill the upload window, retrying failed batches first, */
+/*    unless waiting for a retry or parked */
 function sendHead() {
-   if (to_send.length < 1) return;
-   sending = true;
-   bundle_size = 0;
-
-  endDate = new Date();  
-  seconds = (endDate.getTime() - startDate.getTime()) / 1000;
-  if (to_send.length < cfg_bundle_max && seconds < 5) {
-    sending = false;
-    return;
+  var i;
+
+  if (parked || retry_timer !== null) {
+     updateSending();
+     return;
+  }
+  for (i = 0; i < in_flight.length; i++) {
+     if (in_flight[i].failed) sendBatch(in_flight[i]);
+  }
+
+  while (in_flight.length < cfg_upload_window) {
+     var available = to_send.length() - dispatched;
+     if (available < 1) break;
+
+     var bundle = sizer.current();
+     endDate = new Date();
+     seconds = (endDate.getTime() - startDate.getTime()) / 1000;
+     if (available < bundle && seconds < cfg_flush_delay) {
+        scheduleFlushDeadline();
+        break;
+     }
+     startDate = endDate;
+
+     var batch = {
+        offset: dispatched,
+        count: uploadFormat.uniformCount(queuedRecord,
+            Math.min(bundle, available)),
+        done: false,
+        failed: false,
+        request: null
+     };
+     dispatched += batch.count;
+     in_flight.push(batch);
+     sendBatch(batch);
+  }
+
+  updateSending();
+}
+
+/* queuedRecord - record i positions after the last dispatched one */
+function queuedRecord(i) {
+  return to_send.get(dispatched + i);
+}
+
+/* updateSending - whether an upload request is still pending */
+function updateSending() {
+  sending = false;
+  for (var i = 0; i < in_flight.length; i++) {
+     if (in_flight[i].request) sending = true;
+  }
+}
+
+/* scheduleFlushDeadline - send a partial batch once the delay is over */
+function scheduleFlushDeadline() {
+  if (flush_timer !== null) return;
+  var delay = cfg_flush_delay * 1000 - (Date.now() - startDate.getTime());
+  flush_timer = setTimeout(function () {
+     flush_timer = null;
+     sendHead();
+  }, Math.max(0, delay));
+}
+
+/* abortUploads - forget every batch in flight */
+function abortUploads() {
+  for (var i = 0; i < in_flight.length; i++) {
+     if (in_flight[i].request) in_flight[i].request.abort();
+  }
+  in_flight = [];
+  dispatched = 0;
+  sending = false;
+  if (flush_timer !== null) clearTimeout(flush_timer);
+  flush_timer = null;
+  if (retry_timer !== null) clearTimeout(retry_timer);
+  retry_timer = null;
+  retry_attempts = 0;
+}
+
+/* unqueuedFrom - first key from the given one that was not queued yet */
+function unqueuedFrom(key) {
+  var base = parseInt(localStorage.getItem("lastSent") || "0", 10);
+
+  if (cfg_newest_first) return queued_ranges.skip(Math.max(key, base + 1));
+  return Math.max(key, (last_queued !== null ? last_queued : base) + 1);
+}
+
+/* enqueueLines - queue CSV lines along with their keys */
+/*    and the number of minutes of the runs among them, if any, */
+/*    or the resolution of rollup lines, skipping the minutes already */
+/*    queued, which the watch sends again when an acknowledgement is lost */
+function enqueueLines(keys, lines, spans, resolution) {
+  var records = [];
+  var first_key = null;
+  var last_key = null;
+
+  for (var i = 0; i < lines.length; i++) {
+    var key = keys[i];
+    var span = spans ? spans[i] : 1;
+    var last = key + (resolution || span) - 1;
+    var start = unqueuedFrom(key);
+
+    if (start > last) continue;
+    /* a rollup bucket holding lastSent + 1 is kept whole, the watch */
+    /*    starts its first bucket on the boundary before it */
+    if (start > key && !resolution) {
+      /* the end of a run that was partly queued */
+      lines[i] = wireFormat.timestamp(start)
+          + lines[i].substring(lines[i].indexOf(","));
+      span = last - start + 1;
+      key = start;
+    }
+    if (resolution) {
+      records.push(key + ";" + lines[i] + ";r" + resolution);
+    } else {
+      records.push(key + ";" + lines[i] + (span > 1 ? ";" + span : ""));
+    }
+    if (first_key === null) first_key = key;
+    last_key = last;
+    if (!cfg_newest_first) last_queued = last;
   }
-  
-  startDate = endDate;
+  if (records.length < 1) return;
 
-  var payload = [];
-  while (bundle_size < cfg_bundle_max && bundle_size < to_send.length) {
-     payload.push(to_send[bundle_size].split(";")[1]);
-     bundle_size += 1;
+  if (cfg_newest_first) {
+     /* only the minutes following lastSent without a hole move it */
+     var base = parseInt(localStorage.getItem("lastSent") || "0", 10);
+     queued_ranges.add(first_key, last_key);
+     queued_ranges.dropBelow(base + 1);
+     last_queued = queued_ranges.skip(base + 1) - 1;
   }
+  to_send.push(records);
+  stats.record("queueDepth", to_send.length());
+  if (session_timer !== null) clearTimeout(session_timer);
+  session_timer = null;
+
+  if (!sending) Pebble.sendAppMessage({ "uploadStart": first_key });
+  /* sendHead waits for a full batch or the flush deadline */
+  if (in_flight.length < cfg_upload_window) sendHead();
+}
+
+/* enqueue - unpack a batch of newline-separated lines of consecutive keys */
+function enqueue(key, data) {
+  var lines = String(data).split("\n");
+  var first_key = parseInt(key, 10);
+  var keys = [];
+
+  for (var i = 0; i < lines.length; i++) {
+    keys.push(first_key + i);
+  }
+  enqueueLines(keys, lines);
+}
 
-  console.log("BundleSize : " + parseInt(bundle_size) + " Seconds : " + parseInt(seconds));
-  sendPayload(payload);
+/* enqueueBinary - decode and queue a wire format block */
+function enqueueBinary(bytes) {
+  var block;
+  try {
+    block = wireFormat.decode(bytes);
+  } catch (e) {
+    console.log("Dropping binary block: " + e.message);
+    return;
+  }
+  enqueueLines(block.keys, block.lines, block.spans, block.resolution);
 }
 
-function enqueue(key, line) {
-  to_send.push(key + ";" + line);
-  localStorage.setItem("toSend", to_send.join("|"));
+/* saveLastSent - store the key the next export starts after */
+function saveLastSent(key) {
   localStorage.setItem("lastSent", key);
 
-  // Update Last Sent Key to value being queued
+  // Update Last Sent Key in the configuration page
   var claysettings = JSON.parse(localStorage.getItem('clay-settings'));
-  claysettings.lastSent = key;
-  localStorage.setItem("clay-settings",JSON.stringify(claysettings));
-   
-  if (to_send.length > 1 && !sending) {
-      Pebble.sendAppMessage({ "uploadStart": parseInt(key, 10) });
-      sendHead();
+  if (claysettings) {
+    claysettings.lastSent = key;
+    localStorage.setItem("clay-settings",JSON.stringify(claysettings));
   }
 }
 
-function uploadDone() {
-   sending = false;
-   if (bundle_size > 1) {
-      to_send.splice(0, bundle_size - 1);
+/* persistCursors - save the last queued key, once the queue is flushed */
+function persistCursors() {
+  if (last_queued === null) return;
+  saveLastSent(last_queued);
+  localStorage.setItem("queuedRanges", queued_ranges.toString());
+  last_queued = null;
+}
+
+to_send.onFlush = persistCursors;
+
+/* endSession - report the statistics of the uploads since the last one */
+function endSession() {
+   session_timer = null;
+   if (!stats.counters.requests) return;
+   console.log("Session statistics : " + stats);
+
+   if (cfg_stats_endpoint) {
+      var sender = new XMLHttpRequest();
+      sender.open("POST", cfg_stats_endpoint, true);
+      sender.setRequestHeader("Authorization", "Token token="+cfg_auth_token);
+      sender.setRequestHeader("Content-Type", "application/json;charset=UTF-8");
+      sender.send(JSON.stringify(stats));
+   }
+   stats.reset();
+}
+
+/* scheduleSessionEnd - end the session if nothing is queued for a while */
+function scheduleSessionEnd() {
+   if (session_timer !== null) clearTimeout(session_timer);
+   session_timer = setTimeout(endSession, SESSION_IDLE_MS);
+}
+
+/* ackRanges - send the key ranges of the first records of to_send */
+/*    to the watch, a new range starting wherever the keys go back */
+function ackRanges(count) {
+   var first = uploadFormat.recordKey(to_send.get(0));
+   var last = uploadFormat.recordLastKey(to_send.get(0));
+
+   for (var i = 1; i < count; i++) {
+      var record = to_send.get(i);
+      var key = uploadFormat.recordKey(record);
+      if (key <= last) {
+         Pebble.sendAppMessage({ "uploadFirst": first, "uploadDone": last });
+         first = key;
+      }
+      last = uploadFormat.recordLastKey(record);
    }
+   Pebble.sendAppMessage({ "uploadFirst": first, "uploadDone": last });
+}
 
-   var sent_key = to_send.shift().split(";")[0];
-   localStorage.setItem("toSend", to_send.join("|"));
+/* uploadDone - acknowledge the contiguous prefix of completed batches */
+function uploadDone(batch) {
+   var acked = 0;
+   var latency = Date.now() - batch.sent_at;
+   batch.done = true;
+   batch.request = null;
+   retry_attempts = 0;
+   sizer.success(batch.count, batch.bytes, latency);
+   stats.count("requests");
+   stats.count("records", batch.count);
+   stats.count("bytes", batch.bytes);
+   stats.count("rawBytes", batch.raw_bytes);
+   stats.record("httpLatency", latency);
+   stats.record("batchSize", batch.count);
 
-   Pebble.sendAppMessage({ "uploadDone": parseInt(sent_key, 10) });
+   while (in_flight.length > 0 && in_flight[0].done) {
+      acked += in_flight.shift().count;
+   }
+
+   if (acked > 0) {
+      ackRanges(acked);
+      to_send.drop(acked);
+      dispatched -= acked;
+      for (var i = 0; i < in_flight.length; i++) {
+         in_flight[i].offset -= acked;
+      }
+   }
 
    sendHead();
+   if (to_send.length() < 1 && in_flight.length < 1) scheduleSessionEnd();
+}
+
+/* failureText - status of a failed request, for the logs */
+function failureText(sender) {
+   return (sender.status ? sender.status + " " : "")
+       + (sender.statusText || "network error");
+}
+
+/* scheduleRetry - run sendHead again once the backoff delay is over, */
+/*    or the delay asked with Retry-After, and return the delay in ms */
+function scheduleRetry(sender) {
+   if (retry_timer !== null) return retry_at - Date.now();
+
+   var delay = Math.min(RETRY_MAX_MS,
+       RETRY_BASE_MS * Math.pow(2, retry_attempts));
+   var after = parseInt(sender.getResponseHeader("Retry-After"), 10);
+
+   /* full delay at most, half of it at least */
+   delay = Math.round(delay * (0.5 + Math.random() / 2));
+   if (after >= 0) delay = Math.min(RETRY_MAX_MS, after * 1000);
+   retry_attempts += 1;
+   retry_at = Date.now() + delay;
+   retry_timer = setTimeout(function () {
+      retry_timer = null;
+      sendHead();
+   }, delay);
+   return delay;
+}
+
+/* uploadError - keep the batch in the window, to be sent again by sendHead */
+/*    after a backoff delay, which the watch shows */
+function uploadError(batch, sender) {
+   batch.failed = true;
+   batch.request = null;
+   sizer.failure();
+   stats.count("requests");
+   stats.count("failures");
+   console.log("Batch sizer : " + sizer);
+   updateSending();
+   var delay = Math.ceil(scheduleRetry(sender) / 1000);
+   console.log(failureText(sender) + ", retry in " + delay + " s");
+   Pebble.sendAppMessage({ "uploadFailed": "retry in " + delay + "s" });
 }
 
-function uploadError() {
-   sending = false;
-   console.log(this.statusText);
-   Pebble.sendAppMessage({ "uploadFailed": this.statusText });
+/* uploadParked - keep the batch and stop uploading until the app restarts */
+function uploadParked(batch, sender) {
+   batch.failed = true;
+   batch.request = null;
+   parked = true;
+   stats.count("requests");
+   stats.count("failures");
+   updateSending();
+   console.log("Uploads parked : " + failureText(sender));
+   Pebble.sendAppMessage({ "uploadFailed": "HTTP " + sender.status });
 }
 
-sender.addEventListener("load", uploadDone);
-sender.addEventListener("error", uploadError);
+/* fetchHighWater - start the watch after the last minute the endpoint */
+/*    has stored, or after last_sent if it cannot tell */
+function fetchHighWater(last_sent) {
+   var request = new XMLHttpRequest();
+
+   function fallback(reason) {
+      console.log("High water mark unavailable: " + reason);
+      Pebble.sendAppMessage({ "lastSent": last_sent });
+   }
+
+   request.addEventListener("load", function () {
+      var key = NaN;
+      if (request.status !== 200) {
+         fallback(request.status + " " + request.statusText);
+         return;
+      }
+      try {
+         key = parseInt(JSON.parse(request.responseText).lastKey, 10);
+      } catch (e) {
+         key = NaN;
+      }
+      if (!(key >= 0)) {
+         fallback("no lastKey in " + request.responseText);
+         return;
+      }
+      /* queued records will be uploaded anyway */
+      if (to_send.length() > 0 && last_sent > key) key = last_sent;
+      console.log("High water mark : " + key);
+      saveLastSent(key);
+      /* as a string, the watch starts there even below its checkpoint */
+      Pebble.sendAppMessage({ "lastSent": String(key) });
+   });
+   request.addEventListener("error", function () {
+      fallback(request.statusText);
+   });
+   request.open("GET", cfg_high_water_endpoint, true);
+   request.setRequestHeader("Authorization", "Token token="+cfg_auth_token);
+   request.send();
+}
+
+/* startResend - forget what was queued and uploaded, for the watch */
+/*    to export every minute again */
+function startResend(claysettings) {
+   console.log("Initiating Resend");
+   abortUploads();
+   last_queued = null;
+   to_send.clear();
+   queued_ranges.clear();
+   localStorage.setItem("lastSent", "0");
+   localStorage.removeItem("queuedRanges");
+
+   claysettings.resend = false;
+   claysettings.lastSent = 0;
+   localStorage.setItem("clay-settings", JSON.stringify(claysettings));
+   console.log("Resend setup complete");
+}
 
 function loadSettings() {  
   var msg = {};
@@ -130,6 +526,14 @@ function loadSettings() {
    cfg_endpoint = claysettings.cfgEndpoint;
    cfg_auth_token = claysettings.cfgAuthToken;
    cfg_bundle_max = parseInt(claysettings.cfgBundleMax || "1", 10);
+   cfg_upload_window = parseInt(claysettings.cfgUploadWindow || "1", 10);
+   cfg_flush_delay = parseInt(claysettings.cfgFlushDelay, 10);
+   cfg_upload_format = claysettings.cfgUploadFormat || "rows";
+   cfg_endpoint_runs = !!claysettings.cfgEndpointRuns;
+   cfg_stats_endpoint = claysettings.cfgStatsEndpoint || "";
+   cfg_newest_first = (claysettings.cfgExportOrder === "newest");
+   cfg_compress = !!claysettings.cfgUploadCompression;
+   cfg_high_water_endpoint = claysettings.cfgHighWaterEndpoint || "";
    cfg_auto_close = (parseInt(claysettings.cfgAutoClose || "0", 10) > 0);
    cfg_wakeup_time = -1; //parseInt(claysettings.cfgWakeupTime || "-1", 10);
   } catch (e) {
@@ -138,28 +542,30 @@ function loadSettings() {
    return;
   }
 
-  var str_to_send = localStorage.getItem("toSend");
-  to_send = str_to_send ? str_to_send.split("|") : [];
+  to_send.load();
+  parked = false;
+  queued_ranges.parse(localStorage.getItem("queuedRanges"));
 
    if (cfg_bundle_max < 1) cfg_bundle_max = 1;
+   if (cfg_upload_window < 1) cfg_upload_window = 1;
+   if (!(cfg_flush_delay >= 0)) cfg_flush_delay = 5;
+   sizer.setMax(cfg_bundle_max);
    
    // Obey Resend Variable
    if (claysettings.resend) {
-     console.log("Initiating Resend");
-     claysettings.resend = false;
-
-     sender.abort();
-     localStorage.setItem("toSend", "");
-     localStorage.setItem("lastSent", "0");
-     to_send = [];
-     
-     localStorage.setItem("clay-settings",JSON.stringify(claysettings));
-     console.log("Resend setup complete");
+     startResend(claysettings);
+     /* as a string, the watch drops its checkpoint too */
+     Pebble.sendAppMessage({ "lastSent": "0" });
      return;
    }
 
    if (cfg_endpoint) {
       msg.lastSent = parseInt(localStorage.getItem("lastSent") || "0", 10);
+      if (cfg_high_water_endpoint && !cfg_newest_first) {
+         /* a single high water mark cannot describe newest-first holes */
+         fetchHighWater(msg.lastSent);
+         return;
+      }
       Pebble.sendAppMessage(msg);
       return;
    } else {
@@ -169,8 +575,8 @@ function loadSettings() {
       return;
    }
 
-   if (to_send.length >= 1) {
-      msg.uploadStart = parseInt(to_send[0].split(";")[0]);
+   if (to_send.length() >= 1) {
+      msg.uploadStart = uploadFormat.recordKey(to_send.get(0));
       console.log("Upload Start : " + msg.uploadStart);
       Pebble.sendAppMessage(msg);
       sendHead();
@@ -183,8 +589,85 @@ Pebble.addEventListener("ready", function() {
    loadSettings();  
 });
 
+Pebble.addEventListener("showConfiguration", function() {
+   Pebble.openURL(clay.generateUrl());
+});
+
+/* utf8Prefix - longest prefix of text taking at most max_bytes in UTF-8, */
+/*    without splitting a character */
+function utf8Prefix(text, max_bytes) {
+   var bytes = 0;
+
+   for (var i = 0; i < text.length; i++) {
+      var c = text.charCodeAt(i);
+      var size = c < 0x80 ? 1 : c < 0x800 ? 2
+          : (c >= 0xD800 && c < 0xDC00) ? 4 : 3;
+      if (bytes + size > max_bytes) return text.substring(0, i);
+      bytes += size;
+      if (size === 4) i++;
+   }
+   return text;
+}
+
+Pebble.addEventListener("webviewclosed", function(e) {
+   if (!e || !e.response) return;
+   var settings = clay.getSettings(e.response);
+   var claysettings = JSON.parse(localStorage.getItem("clay-settings"));
+   var requested = parseInt(claysettings.lastSent, 10);
+   var last_sent = parseInt(localStorage.getItem("lastSent") || "0", 10);
+
+   PHONE_SETTINGS.forEach(function (name) {
+      delete settings[messageKeys[name]];
+   });
+   /* an unchanged lastSent would rewind the watch below its checkpoint */
+   if (requested === last_sent) delete settings[messageKeys.lastSent];
+   /* resend restarts the watch from the first minute, and the phone */
+   /*    must not skip those minutes as already queued */
+   if (claysettings.resend) {
+      startResend(claysettings);
+      delete settings[messageKeys.lastSent];
+      resend_held = [];
+   }
+   /* the watch persists at most 255 bytes of its strings */
+   ["cfgEndpoint", "cfgAuthToken"].forEach(function (name) {
+      var id = messageKeys[name];
+      if (typeof settings[id] === "string")
+         settings[id] = utf8Prefix(settings[id], 255);
+   });
+   Pebble.sendAppMessage(settings, function() {}, function(error) {
+      var held = resend_held || [];
+      console.log("Unable to send the settings : " + JSON.stringify(error));
+      resend_held = null;
+      held.forEach(receiveData);
+   });
+
+   /* a lastSent lowered on the configuration page exports the minutes */
+   /*    after it again, which are not to be skipped as already queued */
+   if (settings[messageKeys.resend]) return;
+   if (!(requested >= 0) || requested >= last_sent) return;
+   console.log("Last sent lowered to " + requested);
+   last_queued = null;
+   queued_ranges.clear();
+   localStorage.setItem("lastSent", String(requested));
+   localStorage.removeItem("queuedRanges");
+});
+
+/* receiveData - queue the minutes of a message from the watch */
+function receiveData(payload) {
+   if (payload.dataBinary) {
+     enqueueBinary(payload.dataBinary);
+   } else if (payload.dataKey && payload.dataLine) {
+     enqueue(payload.dataKey, payload.dataLine);
+   }
+}
+
 Pebble.addEventListener("appmessage", function(e) {
-   if (e.payload.dataKey && e.payload.dataLine) {
-     enqueue(e.payload.dataKey, e.payload.dataLine);
+   /* the held messages were sent before the watch started over, */
+   /*    it exports their minutes again */
+   if (e.payload.resend) resend_held = null;
+   if (resend_held && (e.payload.dataBinary || e.payload.dataKey)) {
+     resend_held.push(e.payload);
+     return;
    }
+   receiveData(e.payload);
 });
\ No newline at end of file
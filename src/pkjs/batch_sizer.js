@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Adaptive upload batch size, AIMD-style: the size doubles after each
+ * full batch uploaded within the latency target until the first
+ * congestion signal, then grows by INCREASE_STEP records per good batch.
+ * Slow requests, failures and a throughput drop after growing shrink it
+ * multiplicatively. The configured maximum is only an upper bound.
+ */
+
+var MIN_SIZE = 1;
+var INITIAL_SIZE = 16;
+var INCREASE_STEP = 16;
+var DECREASE_FACTOR = 0.5;
+var TARGET_LATENCY_MS = 4000;
+var ERROR_RATE_HOLD = 0.2;
+var EWMA_WEIGHT = 0.25;
+
+function BatchSizer(max) {
+   this.max = max;
+   this.size = INITIAL_SIZE;
+   this.slowStart = true;
+   /* averages, null until their first sample */
+   this.latency = null;
+   this.rate = null;
+   this.errorRate = null;
+   this.grew = false;
+}
+
+function ewma(average, sample) {
+   return average !== null ? average + EWMA_WEIGHT * (sample - average)
+       : sample;
+}
+
+/* setMax - change the upper bound, from the settings */
+BatchSizer.prototype.setMax = function (max) {
+   this.max = Math.max(MIN_SIZE, max);
+};
+
+/* current - number of records to put in the next batch */
+BatchSizer.prototype.current = function () {
+   return Math.max(MIN_SIZE, Math.min(Math.floor(this.size), this.max));
+};
+
+BatchSizer.prototype.decrease = function () {
+   this.size = Math.max(MIN_SIZE, this.size * DECREASE_FACTOR);
+   this.slowStart = false;
+   this.grew = false;
+};
+
+/* success - account an uploaded batch of count records and bytes bytes */
+BatchSizer.prototype.success = function (count, bytes, latency_ms) {
+   var rate = bytes * 1000 / Math.max(1, latency_ms);
+   var full = (count >= this.current());
+
+   this.errorRate = ewma(this.errorRate, 0);
+   this.latency = ewma(this.latency, latency_ms);
+
+   if (latency_ms > TARGET_LATENCY_MS) {
+      this.decrease();
+   } else if (this.grew && this.rate !== null && rate < this.rate * 0.75) {
+      // growing made the link slower, step back
+      this.decrease();
+   } else if (full && this.errorRate < ERROR_RATE_HOLD
+       && this.size < this.max) {
+      this.size = this.slowStart ? this.size * 2 : this.size + INCREASE_STEP;
+      this.size = Math.min(this.size, this.max);
+      this.grew = true;
+   } else {
+      this.grew = false;
+   }
+
+   this.rate = ewma(this.rate, rate);
+};
+
+/* failure - account a batch that could not be uploaded */
+BatchSizer.prototype.failure = function () {
+   this.errorRate = ewma(this.errorRate, 1);
+   this.decrease();
+};
+
+BatchSizer.prototype.toString = function () {
+   return "size " + this.current() + "/" + this.max
+       + ", latency " + Math.round(this.latency) + " ms"
+       + ", " + Math.round(this.rate) + " B/s"
+       + ", errors " + Math.round(this.errorRate * 100) + "%";
+};
+
+module.exports = BatchSizer;
@@ -20,6 +20,45 @@ module.exports = [
         "defaultValue": "10.0.0.25/v1/health_records/batch_create",
         "label": "Endpoint"
       },
+      {
+        "type": "select",
+        "messageKey": "cfgUploadFormat",
+        "defaultValue": "rows",
+        "label": "Upload Format",
+        "description": "Columns send one array of numbers per field, for endpoints supporting it",
+        "options": [
+          { "label": "Rows", "value": "rows" },
+          { "label": "Columns", "value": "columns" }
+        ]
+      },
+      {
+        "type": "toggle",
+        "messageKey": "cfgEndpointRuns",
+        "defaultValue": false,
+        "label": "Endpoint Accepts Runs",
+        "description": "Forward runs of identical idle minutes as a single record with a minute count, instead of one record per minute"
+      },
+      {
+        "type": "toggle",
+        "messageKey": "cfgUploadCompression",
+        "defaultValue": false,
+        "label": "Compress Uploads",
+        "description": "Send request bodies with gzip Content-Encoding, falling back to plain JSON if the endpoint refuses them"
+      },
+      {
+        "type": "input",
+        "messageKey": "cfgStatsEndpoint",
+        "defaultValue": "",
+        "label": "Statistics Endpoint",
+        "description": "Optional URL receiving the upload statistics at the end of each session"
+      },
+      {
+        "type": "input",
+        "messageKey": "cfgHighWaterEndpoint",
+        "defaultValue": "",
+        "label": "High Water Mark Endpoint",
+        "description": "Optional URL answering a GET with the last minute key stored, as {\"lastKey\": N}. The export then starts right after it. Ignored when sending the newest minutes first"
+      },
       {
         "type": "input",
         "messageKey": "cfgAuthToken",
@@ -37,9 +76,29 @@ module.exports = [
       "messageKey": "cfgBundleMax",
       "defaultValue": 50,
       "label": "Max Bundle",
-      "description": "Maximum amount of items to bundle into a batch request",
+      "description": "Upper bound of the amount of items to bundle into a batch request, the actual size adapts to the measured latency and throughput",
       "min": 1,
-      "max": 100,
+      "max": 2000,
+      "step": 1
+      },
+      {
+      "type": "slider",
+      "messageKey": "cfgFlushDelay",
+      "defaultValue": 5,
+      "label": "Partial Bundle Delay",
+      "description": "Seconds to wait for more items before sending an incomplete bundle",
+      "min": 0,
+      "max": 60,
+      "step": 1
+      },
+      {
+      "type": "slider",
+      "messageKey": "cfgUploadWindow",
+      "defaultValue": 4,
+      "label": "Concurrent Uploads",
+      "description": "Maximum amount of batch requests in flight at the same time",
+      "min": 1,
+      "max": 8,
       "step": 1
       }
     ]
@@ -63,6 +122,64 @@ module.exports = [
         "label": "Resend Data",
         "defaultValue": false
       },
+      {
+        "type": "toggle",
+        "messageKey": "cfgCsvLines",
+        "label": "Legacy CSV Transfer",
+        "description": "Send minutes from the watch as CSV lines instead of compact binary records",
+        "defaultValue": false
+      },
+      {
+        "type": "select",
+        "messageKey": "cfgResolution",
+        "defaultValue": "1",
+        "label": "Export Resolution",
+        "description": "Aggregate minutes into buckets on the watch, with step sums, vmc sum and maximum, heart rate range and activities. Ignored by the legacy CSV transfer",
+        "options": [
+          { "label": "1 minute (raw)", "value": "1" },
+          { "label": "5 minutes", "value": "5" },
+          { "label": "15 minutes", "value": "15" },
+          { "label": "1 hour", "value": "60" }
+        ]
+      },
+      {
+        "type": "select",
+        "messageKey": "cfgExportOrder",
+        "defaultValue": "oldest",
+        "label": "Export Order",
+        "description": "Newest first sends the most recent 12 hours first, then backfills older history 12 hours at a time",
+        "options": [
+          { "label": "Oldest first", "value": "oldest" },
+          { "label": "Newest first", "value": "newest" }
+        ]
+      },
+      {
+        "type": "slider",
+        "messageKey": "cfgFrameBudget",
+        "defaultValue": 1000,
+        "label": "Screen Refresh (ms)",
+        "description": "Minimum delay between two updates of the progress screen, longer leaves more time to the export",
+        "min": 100,
+        "max": 5000,
+        "step": 100
+      },
+      {
+        "type": "slider",
+        "messageKey": "cfgRetryBudget",
+        "defaultValue": 10,
+        "label": "Watch Retry Budget",
+        "description": "Number of consecutive failed messages the watch sends again, waiting longer each time, before stopping the export",
+        "min": 0,
+        "max": 50,
+        "step": 1
+      },
+      {
+        "type": "toggle",
+        "messageKey": "cfgBackgroundCollect",
+        "label": "Background Collection",
+        "description": "Run a background worker that reads and encodes new minutes ahead of the next export, so that it starts sending right away. Takes effect when the app exits",
+        "defaultValue": false
+      },
       {
         "type": "slider",
         "messageKey": "cfgWakeupTime",
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Minimal gzip encoder (RFC 1951 and 1952) for request bodies.
+ *
+ * The whole input goes into a single deflate block with the fixed Huffman
+ * codes, so there is no code table to build or to send. Matches are found
+ * through hash chains over the last WINDOW_SIZE bytes, following at most
+ * MAX_CHAIN candidates. Upload bodies are JSON repeating the same field
+ * names and similar values on every record, which LZ77 alone shrinks
+ * several times over.
+ */
+
+var WINDOW_SIZE = 32768;
+var HASH_SIZE = 4096;
+var MIN_MATCH = 3;
+var MAX_MATCH = 258;
+var MAX_CHAIN = 64;
+
+var LENGTH_BASE = [3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258];
+var LENGTH_EXTRA = [0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0];
+var DISTANCE_BASE = [1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193,
+    12289, 16385, 24577];
+var DISTANCE_EXTRA = [0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13];
+
+var crc_table = null;
+
+/* crc32 - CRC of the gzip trailer */
+function crc32(bytes) {
+   var crc = -1;
+   var i, j, c;
+
+   if (!crc_table) {
+      crc_table = [];
+      for (i = 0; i < 256; i++) {
+         c = i;
+         for (j = 0; j < 8; j++) c = (c & 1) ? 0xedb88320 ^ (c >>> 1) : c >>> 1;
+         crc_table.push(c >>> 0);
+      }
+   }
+   for (i = 0; i < bytes.length; i++) {
+      crc = crc_table[(crc ^ bytes[i]) & 0xff] ^ (crc >>> 8);
+   }
+   return (crc ^ -1) >>> 0;
+}
+
+/* utf8 - bytes of a string */
+function utf8(text) {
+   var raw = unescape(encodeURIComponent(text));
+   var bytes = new Uint8Array(raw.length);
+   for (var i = 0; i < raw.length; i++) bytes[i] = raw.charCodeAt(i);
+   return bytes;
+}
+
+/* BitWriter - deflate bit stream, least significant bit first */
+function BitWriter() {
+   this.bytes = [];
+   this.bits = 0;
+   this.count = 0;
+}
+
+BitWriter.prototype.write = function (value, length) {
+   this.bits |= value << this.count;
+   this.count += length;
+   while (this.count >= 8) {
+      this.bytes.push(this.bits & 0xff);
+      this.bits >>>= 8;
+      this.count -= 8;
+   }
+};
+
+/* writeCode - Huffman codes go most significant bit first */
+BitWriter.prototype.writeCode = function (code, length) {
+   var reversed = 0;
+   for (var i = 0; i < length; i++) {
+      reversed = (reversed << 1) | ((code >>> i) & 1);
+   }
+   this.write(reversed, length);
+};
+
+BitWriter.prototype.flush = function () {
+   if (this.count > 0) this.bytes.push(this.bits & 0xff);
+   this.bits = this.count = 0;
+};
+
+/* writeSymbol - literal or length symbol with the fixed codes */
+function writeSymbol(out, symbol) {
+   if (symbol < 144) out.writeCode(0x30 + symbol, 8);
+   else if (symbol < 256) out.writeCode(0x190 + symbol - 144, 9);
+   else if (symbol < 280) out.writeCode(symbol - 256, 7);
+   else out.writeCode(0xc0 + symbol - 280, 8);
+}
+
+/* findCode - index of the last base not greater than value */
+function findCode(base, value) {
+   var code = base.length - 1;
+   while (base[code] > value) code--;
+   return code;
+}
+
+function writeMatch(out, length, distance) {
+   var code = findCode(LENGTH_BASE, length);
+   writeSymbol(out, 257 + code);
+   out.write(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+   code = findCode(DISTANCE_BASE, distance);
+   out.writeCode(code, 5);
+   out.write(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+function hash(bytes, i) {
+   return ((bytes[i] << 8) ^ (bytes[i + 1] << 4) ^ bytes[i + 2])
+       & (HASH_SIZE - 1);
+}
+
+/* deflate - compress bytes into out as a single fixed Huffman block */
+function deflate(bytes, out) {
+   var head = new Int32Array(HASH_SIZE);
+   var prev = new Int32Array(WINDOW_SIZE);
+   var i = 0;
+
+   for (var h = 0; h < HASH_SIZE; h++) head[h] = -1;
+   out.write(1, 1);
+   out.write(1, 2);
+
+   /* insert - make position p a match candidate */
+   function insert(p) {
+      var key = hash(bytes, p);
+      prev[p & (WINDOW_SIZE - 1)] = head[key];
+      head[key] = p;
+   }
+
+   while (i < bytes.length) {
+      var best_length = 0;
+      var best_distance = 0;
+
+      if (i + MIN_MATCH <= bytes.length) {
+         var limit = Math.min(MAX_MATCH, bytes.length - i);
+         var candidate = head[hash(bytes, i)];
+         var chain = MAX_CHAIN;
+
+         while (candidate >= 0 && i - candidate <= WINDOW_SIZE
+             && chain-- > 0) {
+            var length = 0;
+            while (length < limit
+                && bytes[candidate + length] === bytes[i + length]) {
+               length++;
+            }
+            if (length > best_length) {
+               best_length = length;
+               best_distance = i - candidate;
+               if (length === limit) break;
+            }
+            candidate = prev[candidate & (WINDOW_SIZE - 1)];
+         }
+         insert(i);
+      }
+
+      if (best_length >= MIN_MATCH) {
+         writeMatch(out, best_length, best_distance);
+         for (var j = 1; j < best_length; j++) {
+            if (i + j + MIN_MATCH <= bytes.length) insert(i + j);
+         }
+         i += best_length;
+      } else {
+         writeSymbol(out, bytes[i]);
+         i++;
+      }
+   }
+   writeSymbol(out, 256);
+   out.flush();
+}
+
+/* gzip - compress a string into a gzip member, as a Uint8Array */
+function gzip(text) {
+   var bytes = utf8(text);
+   var out = new BitWriter();
+   var crc = crc32(bytes);
+   var size = bytes.length;
+
+   out.bytes.push(0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff);
+   deflate(bytes, out);
+   out.bytes.push(crc & 0xff, (crc >>> 8) & 0xff, (crc >>> 16) & 0xff,
+       crc >>> 24, size & 0xff, (size >>> 8) & 0xff, (size >>> 16) & 0xff,
+       size >>> 24);
+   return new Uint8Array(out.bytes);
+}
+
+module.exports.gzip = gzip;
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Set of minute keys, as sorted disjoint ranges of consecutive keys,
+ * the counterpart of key_ranges.c on the watch. It is stored as
+ * "first-last" pairs separated by commas. When more than MAX_RANGES
+ * are needed, the highest range is forgotten, so the set only ever
+ * under-reports.
+ */
+
+var MAX_RANGES = 32;
+
+function KeyRanges() {
+   this.ranges = [];
+}
+
+/* add - insert keys [first, last], merging adjacent ranges */
+KeyRanges.prototype.add = function (first, last) {
+   var ranges = this.ranges;
+   var i = 0;
+
+   if (first > last) return;
+   while (i < ranges.length && ranges[i][1] < first - 1) i++;
+   var j = i;
+   while (j < ranges.length && ranges[j][0] <= last + 1) {
+      if (ranges[j][0] < first) first = ranges[j][0];
+      if (ranges[j][1] > last) last = ranges[j][1];
+      j++;
+   }
+   ranges.splice(i, j - i, [first, last]);
+   if (ranges.length > MAX_RANGES) ranges.pop();
+};
+
+/* skip - first key from the given one that is not in the set */
+KeyRanges.prototype.skip = function (key) {
+   for (var i = 0; i < this.ranges.length; i++) {
+      var range = this.ranges[i];
+      if (range[0] > key) break;
+      if (range[1] >= key) key = range[1] + 1;
+   }
+   return key;
+};
+
+/* dropBelow - forget the keys lower than the given one */
+KeyRanges.prototype.dropBelow = function (key) {
+   while (this.ranges.length > 0 && this.ranges[0][1] < key) {
+      this.ranges.shift();
+   }
+   if (this.ranges.length > 0 && this.ranges[0][0] < key) {
+      this.ranges[0][0] = key;
+   }
+};
+
+/* clear - forget every key */
+KeyRanges.prototype.clear = function () {
+   this.ranges = [];
+};
+
+KeyRanges.prototype.toString = function () {
+   return this.ranges.map(function (range) {
+      return range[0] + "-" + range[1];
+   }).join(",");
+};
+
+/* parse - load the set from its string form */
+KeyRanges.prototype.parse = function (text) {
+   this.clear();
+   if (!text) return;
+   var pairs = String(text).split(",");
+   for (var i = 0; i < pairs.length; i++) {
+      var bounds = pairs[i].split("-");
+      var first = parseInt(bounds[0], 10);
+      var last = parseInt(bounds[1], 10);
+      if (first >= 0 && last >= first) this.add(first, last);
+   }
+};
+
+module.exports = KeyRanges;
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Upload statistics of a session: counters, and histograms of values
+ * with power-of-two buckets, bucket n counting values in [2^(n-1), 2^n)
+ * and bucket 0 the values under 1.
+ */
+
+var BUCKET_COUNT = 16;
+
+function Histogram() {
+   this.count = 0;
+   this.total = 0;
+   this.max = 0;
+   this.buckets = [];
+   for (var i = 0; i < BUCKET_COUNT; i++) this.buckets.push(0);
+}
+
+Histogram.prototype.record = function (value) {
+   var n = 0;
+   while (n + 1 < BUCKET_COUNT && value >= Math.pow(2, n)) n++;
+   this.count += 1;
+   this.total += value;
+   this.max = Math.max(this.max, value);
+   this.buckets[n] += 1;
+};
+
+/* percentile - upper bound of the bucket holding it, at most max */
+Histogram.prototype.percentile = function (percent) {
+   var target = Math.ceil(this.count * percent / 100);
+   var seen = 0;
+
+   for (var n = 0; n < BUCKET_COUNT - 1; n++) {
+      seen += this.buckets[n];
+      if (seen >= target && seen > 0) break;
+   }
+   return Math.min(Math.pow(2, n) - 1, this.max);
+};
+
+Histogram.prototype.toJSON = function () {
+   return {
+      count: this.count,
+      average: this.count ? this.total / this.count : 0,
+      p50: this.percentile(50),
+      p90: this.percentile(90),
+      max: this.max,
+      buckets: this.buckets
+   };
+};
+
+Histogram.prototype.toString = function () {
+   var average = this.count ? Math.round(this.total / this.count) : 0;
+   return this.count + "x " + average + "/" + this.percentile(90)
+       + "/" + this.max;
+};
+
+function PerfStats() {
+   this.reset();
+}
+
+/* reset - start a new session */
+PerfStats.prototype.reset = function () {
+   this.started = Date.now();
+   this.counters = { requests: 0, failures: 0, records: 0, bytes: 0,
+       rawBytes: 0 };
+   this.histograms = {
+      queueDepth: new Histogram(),
+      httpLatency: new Histogram(),
+      batchSize: new Histogram()
+   };
+};
+
+/* record - add a value to the named histogram */
+PerfStats.prototype.record = function (name, value) {
+   this.histograms[name].record(value);
+};
+
+/* count - increase the named counter */
+PerfStats.prototype.count = function (name, value) {
+   this.counters[name] += (value === undefined ? 1 : value);
+};
+
+PerfStats.prototype.toJSON = function () {
+   return {
+      started: new Date(this.started).toISOString(),
+      duration_ms: Date.now() - this.started,
+      counters: this.counters,
+      queueDepth: this.histograms.queueDepth.toJSON(),
+      httpLatency: this.histograms.httpLatency.toJSON(),
+      batchSize: this.histograms.batchSize.toJSON()
+   };
+};
+
+/* toString - one line summary, histograms as count avg/p90/max */
+PerfStats.prototype.toString = function () {
+   return this.counters.records + " records in "
+       + this.counters.requests + " requests ("
+       + this.counters.failures + " failed, "
+       + this.counters.bytes + " bytes"
+       + (this.counters.rawBytes !== this.counters.bytes
+           ? " from " + this.counters.rawBytes : "") + ")"
+       + ", queue depth " + this.histograms.queueDepth
+       + ", HTTP latency " + this.histograms.httpLatency + " ms"
+       + ", batch size " + this.histograms.batchSize;
+};
+
+module.exports = PerfStats;
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Append-only queue of "key;line" records waiting for upload.
+ *
+ * Records are numbered with an ever-increasing sequence number and
+ * persisted in localStorage as fixed-size segments "toSend.<n>", holding
+ * the records of sequence numbers [n * SEGMENT_SIZE, (n + 1) * SEGMENT_SIZE)
+ * prefixed by the sequence number of the first one stored.
+ * "toSendHead" and "toSendTail" are the sequence numbers of the first
+ * record to upload and of the next record to append.
+ *
+ * Writes are batched: only the segments touched since the last flush are
+ * rewritten, every FLUSH_RECORDS records or FLUSH_DELAY_MS milliseconds,
+ * and the onFlush callback is called afterwards so that cursors depending
+ * on the queue are persisted along with it.
+ */
+
+var SEGMENT_SIZE = 256;
+var FLUSH_RECORDS = 256;
+var FLUSH_DELAY_MS = 2000;
+var COMPACT_MIN = 1024;
+
+function segmentKey(segment) {
+   return "toSend." + segment;
+}
+
+function SendQueue() {
+   this.items = [];
+   this.offset = 0;
+   this.head = 0;
+   this.tail = 0;
+   this.storedHead = 0;
+   this.dirtySegment = -1;
+   this.pending = 0;
+   this.flushTimer = null;
+   this.onFlush = null;
+}
+
+/* length - number of records waiting for upload */
+SendQueue.prototype.length = function () {
+   return this.tail - this.head;
+};
+
+/* get - record at the given position from the head */
+SendQueue.prototype.get = function (i) {
+   return this.items[this.offset + i];
+};
+
+/* push - append records, persisted on the next flush */
+SendQueue.prototype.push = function (records) {
+   if (records.length < 1) return;
+   var segment = Math.floor(this.tail / SEGMENT_SIZE);
+
+   if (this.dirtySegment < 0 || segment < this.dirtySegment) {
+      this.dirtySegment = segment;
+   }
+   for (var i = 0; i < records.length; i++) {
+      this.items.push(records[i]);
+   }
+   this.tail += records.length;
+   this.pending += records.length;
+
+   if (this.pending >= FLUSH_RECORDS) {
+      this.flush();
+   } else {
+      this.scheduleFlush();
+   }
+};
+
+/* drop - remove n records from the head, returning the last one removed */
+SendQueue.prototype.drop = function (n) {
+   if (n > this.length()) n = this.length();
+   if (n < 1) return null;
+
+   var last = this.items[this.offset + n - 1];
+   this.offset += n;
+   this.head += n;
+
+   if (this.offset >= COMPACT_MIN && this.offset * 2 >= this.items.length) {
+      this.items = this.items.slice(this.offset);
+      this.offset = 0;
+   }
+
+   this.scheduleFlush();
+   return last;
+};
+
+/* clear - drop every record and their storage */
+SendQueue.prototype.clear = function () {
+   this.head = this.tail;
+   this.items = [];
+   this.offset = 0;
+   this.dirtySegment = -1;
+   this.flush();
+};
+
+SendQueue.prototype.scheduleFlush = function () {
+   if (this.flushTimer !== null) return;
+   var queue = this;
+   this.flushTimer = setTimeout(function () {
+      queue.flushTimer = null;
+      queue.flush();
+   }, FLUSH_DELAY_MS);
+};
+
+/* flush - write the touched segments and the cursors */
+SendQueue.prototype.flush = function () {
+   var segment;
+
+   if (this.flushTimer !== null) {
+      clearTimeout(this.flushTimer);
+      this.flushTimer = null;
+   }
+
+   if (this.dirtySegment >= 0 && this.tail > this.head) {
+      var first = Math.max(this.dirtySegment,
+          Math.floor(this.head / SEGMENT_SIZE));
+      var last = Math.floor((this.tail - 1) / SEGMENT_SIZE);
+
+      for (segment = first; segment <= last; segment++) {
+         var start = Math.max(this.head, segment * SEGMENT_SIZE);
+         var end = Math.min(this.tail, (segment + 1) * SEGMENT_SIZE);
+         var records = this.items.slice(this.offset + start - this.head,
+             this.offset + end - this.head);
+         localStorage.setItem(segmentKey(segment),
+             start + "|" + records.join("|"));
+      }
+   }
+   this.dirtySegment = -1;
+   this.pending = 0;
+
+   var headSegment = Math.floor(this.head / SEGMENT_SIZE);
+   if (this.head === this.tail) headSegment = Math.ceil(this.tail / SEGMENT_SIZE);
+   for (segment = Math.floor(this.storedHead / SEGMENT_SIZE);
+       segment < headSegment; segment++) {
+      localStorage.removeItem(segmentKey(segment));
+   }
+   this.storedHead = this.head;
+
+   localStorage.setItem("toSendHead", this.head);
+   localStorage.setItem("toSendTail", this.tail);
+
+   if (this.onFlush) this.onFlush();
+};
+
+/* load - restore the queue from localStorage */
+SendQueue.prototype.load = function () {
+   this.head = parseInt(localStorage.getItem("toSendHead") || "0", 10);
+   this.tail = parseInt(localStorage.getItem("toSendTail") || "0", 10);
+   this.items = [];
+   this.offset = 0;
+   this.storedHead = this.head;
+   this.dirtySegment = -1;
+   this.pending = 0;
+
+   if (this.tail > this.head) {
+      var first = Math.floor(this.head / SEGMENT_SIZE);
+      var last = Math.floor((this.tail - 1) / SEGMENT_SIZE);
+
+      for (var segment = first; segment <= last; segment++) {
+         var stored = localStorage.getItem(segmentKey(segment));
+         var start = Math.max(this.head, segment * SEGMENT_SIZE);
+         var end = Math.min(this.tail, (segment + 1) * SEGMENT_SIZE);
+         var records = stored ? stored.split("|") : [];
+         var skip = start - parseInt(records.shift(), 10);
+
+         if (!stored || skip < 0 || records.length < end - start + skip) {
+            console.log("Send queue segment " + segment + " is damaged,"
+                + " keeping " + this.items.length + " records");
+            this.tail = this.head + this.items.length;
+            this.dirtySegment = segment;
+            break;
+         }
+         for (var i = skip; i < skip + end - start; i++) {
+            this.items.push(records[i]);
+         }
+      }
+   }
+
+   // Import the queue of earlier versions, stored as a single string
+   var legacy = localStorage.getItem("toSend");
+   if (legacy !== null) {
+      localStorage.removeItem("toSend");
+      if (legacy) this.push(legacy.split("|"));
+      this.flush();
+   }
+};
+
+module.exports = SendQueue;
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Request bodies built from queued "key;line" records, or "key;line;N"
+ * for a run of N identical minutes starting at key, or "key;line;rN" for
+ * a rollup of the N minutes starting at key (see wire_format.js).
+ *
+ * Unless the endpoint accepts runs, they are expanded into one minute
+ * each before building the body. Otherwise the run length is forwarded
+ * as "minutes", on the row in rows and as an array in columns, only
+ * present when a run is in the body.
+ *
+ * rows: an array of one object per minute, with the CSV fields as strings.
+ *
+ * columns: a single object with the RFC-3339 "start" of the first minute,
+ * "step" in seconds between minutes, and one array of numbers per field,
+ * where invalid minutes are null except for their activity mask.
+ * "offsets" lists the minutes since start of each record, and is only
+ * present when the records are not consecutive.
+ *
+ * Rollups use ROLLUP_FIELDS instead, along with their "resolution" in
+ * minutes, and "step" is the resolution in seconds in columns. A body
+ * holds either minutes or rollups, never both.
+ *
+ * Each body is sent along with the range of minute keys it covers and a
+ * hash of its JSON text, which identify it for deduplication.
+ */
+
+var wireFormat = require('./wire_format.js');
+
+var FIELDS = ["steps", "yaw", "pitch", "vmc", "light", "activity", "hrbpm"];
+var ROLLUP_FIELDS = ["invalid", "steps", "vmc", "vmcMax",
+    "hrMin", "hrAvg", "hrMax", "activity", "light"];
+
+/* recordKey - key of the first minute of a queued record */
+function recordKey(record) {
+   return parseInt(record.split(";")[0], 10);
+}
+
+/* recordSpan - number of minutes of a queued record */
+function recordSpan(record) {
+   var extra = record.split(";")[2];
+   return extra ? parseInt(extra.replace(/^r/, ""), 10) : 1;
+}
+
+/* recordLastKey - key of the last minute of a queued record */
+function recordLastKey(record) {
+   return recordKey(record) + recordSpan(record) - 1;
+}
+
+/* isRollup - whether a queued record is a rollup */
+function isRollup(record) {
+   var extra = record.split(";")[2];
+   return !!extra && extra.charAt(0) === "r";
+}
+
+/* expand - turn every run into as many single minute records */
+function expand(records) {
+   var result = [];
+
+   for (var i = 0; i < records.length; i++) {
+      var span = recordSpan(records[i]);
+      if (span <= 1 || isRollup(records[i])) {
+         result.push(records[i]);
+         continue;
+      }
+
+      var parts = records[i].split(";");
+      var key = parseInt(parts[0], 10);
+      var fields = parts[1].substring(parts[1].indexOf(","));
+      for (var j = 0; j < span; j++) {
+         result.push((key + j) + ";" + wireFormat.timestamp(key + j) + fields);
+      }
+   }
+
+   return result;
+}
+
+function rows(records) {
+   var payload_array = [];
+   var counter = 0;
+  
+   while (counter < records.length) {
+     var data = {};
+     var parts = records[counter].split(";");
+     var components = parts[1].split(',');
+     data.timestamp = components[0];
+     if (isRollup(records[counter])) {
+       data.resolution = String(recordSpan(records[counter]));
+       for (var f = 0; f < ROLLUP_FIELDS.length; f++) {
+         data[ROLLUP_FIELDS[f]] = components[f + 1];
+       }
+       payload_array.push(data);
+       counter++;
+       continue;
+     }
+     data.steps = components[1];
+     data.yaw = components[2];
+     data.pitch = components[3];
+     data.vmc = components[4];
+     data.light = components[5];
+     data.activity = components[6];
+     data.hrbpm = components[7];
+     if (parts[2]) data.minutes = parts[2];
+     payload_array.push(data);
+     counter++;
+    }
+
+   return payload_array;
+}
+
+function columns(records) {
+   var rollup = records.length > 0 && isRollup(records[0]);
+   var fields = rollup ? ROLLUP_FIELDS : FIELDS;
+   var resolution = rollup ? recordSpan(records[0]) : 1;
+   var payload = { start: null, step: 60 * resolution, count: records.length };
+   var offsets = [];
+   var minutes = [];
+   var contiguous = true;
+   var runs = false;
+   var first_key = null;
+   var i, f;
+
+   if (rollup) payload.resolution = resolution;
+   for (f = 0; f < fields.length; f++) {
+      payload[fields[f]] = [];
+   }
+
+   for (i = 0; i < records.length; i++) {
+      var parts = records[i].split(";");
+      var key = parseInt(parts[0], 10);
+      var components = parts[1].split(",");
+
+      if (first_key === null) {
+         first_key = key;
+         payload.start = components[0];
+      }
+      offsets.push(key - first_key);
+      if (key - first_key !== i * resolution) contiguous = false;
+      if (!rollup) {
+         minutes.push(recordSpan(records[i]));
+         if (parts[2]) runs = true;
+      }
+
+      for (f = 0; f < fields.length; f++) {
+         var value = components[f + 1];
+         payload[fields[f]].push(value === "" || value === undefined
+             ? null : Number(value));
+      }
+   }
+
+   if (!contiguous) payload.offsets = offsets;
+   if (runs) payload.minutes = minutes;
+   return payload;
+}
+
+/* resolution - minutes per row of a queued record, 1 for minutes and runs */
+function resolution(record) {
+   return isRollup(record) ? recordSpan(record) : 1;
+}
+
+/* uniformCount - how many of the first count records, read with get(i), */
+/*    can share a body, stopping before a change of resolution */
+function uniformCount(get, count) {
+   var first = resolution(get(0));
+   for (var i = 1; i < count; i++) {
+      if (resolution(get(i)) !== first) return i;
+   }
+   return count;
+}
+
+/* keyRange - "first-last" minute keys covered by the records */
+function keyRange(records) {
+   var first = recordKey(records[0]);
+   var last = recordLastKey(records[0]);
+   for (var i = 1; i < records.length; i++) {
+      first = Math.min(first, recordKey(records[i]));
+      last = Math.max(last, recordLastKey(records[i]));
+   }
+   return first + "-" + last;
+}
+
+/* hash - FNV-1a 32-bit hash of a body, in hexadecimal */
+function hash(body) {
+   var value = 0x811c9dc5;
+   for (var i = 0; i < body.length; i++) {
+      value = Math.imul(value ^ body.charCodeAt(i), 0x01000193);
+   }
+   return ("0000000" + (value >>> 0).toString(16)).slice(-8);
+}
+
+/* build - request body of the given format for the records */
+function build(format, records, runs) {
+   if (!runs) records = expand(records);
+   return JSON.stringify(format === "columns"
+       ? columns(records) : rows(records));
+}
+
+module.exports.build = build;
+module.exports.recordKey = recordKey;
+module.exports.recordLastKey = recordLastKey;
+module.exports.uniformCount = uniformCount;
+module.exports.keyRange = keyRange;
+module.exports.hash = hash;
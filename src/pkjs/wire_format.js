@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Decoder of the binary minute records, layout in src/c/wire_format.h */
+
+var VERSION = 2;
+var TYPE_MINUTE = 1;
+var TYPE_ROLLUP = 2;
+var HEADER_SIZE = 8;
+var RECORD_SIZE = 8;
+var ROLLUP_SIZE = 16;
+var FLAG_LIGHT_MASK = 0x07;
+var FLAG_RUN = 0x40;
+var FLAG_INVALID = 0x80;
+
+function getU16(bytes, i) {
+   return bytes[i] | (bytes[i + 1] << 8);
+}
+
+function getI32(bytes, i) {
+   return bytes[i] | (bytes[i + 1] << 8) | (bytes[i + 2] << 16)
+       | (bytes[i + 3] << 24);
+}
+
+/* timestamp - RFC-3339 representation of a minute key, as on the watch */
+function timestamp(key) {
+   return new Date(key * 60000).toISOString().replace(/\.\d{3}Z$/, "Z");
+}
+
+/* minuteLine - CSV line of a minute record, as minute_data_image builds */
+function minuteLine(bytes, i, key) {
+   var activity = bytes[i + 6];
+
+   if (bytes[i + 3] & FLAG_INVALID) {
+      return timestamp(key) + ",,,,,," + activity + ",";
+   }
+
+   return timestamp(key)
+       + "," + bytes[i + 1]
+       + "," + (bytes[i + 2] & 0xF)
+       + "," + (bytes[i + 2] >> 4)
+       + "," + ((bytes[i + 3] & FLAG_RUN) ? 0 : getU16(bytes, i + 4))
+       + "," + (bytes[i + 3] & FLAG_LIGHT_MASK)
+       + "," + activity
+       + "," + bytes[i + 7];
+}
+
+/* rollupLine - CSV line of a rollup record: timestamp, invalid minutes, */
+/*    steps, vmc sum and max, heart rate min, avg and max, activity, light */
+function rollupLine(bytes, i, key) {
+   var hr = bytes[i + 11]
+       ? bytes[i + 10] + "," + bytes[i + 11] + "," + bytes[i + 12] : ",,";
+
+   return timestamp(key)
+       + "," + bytes[i + 1]
+       + "," + getU16(bytes, i + 2)
+       + "," + (getI32(bytes, i + 4) >>> 0)
+       + "," + getU16(bytes, i + 8)
+       + "," + hr
+       + "," + bytes[i + 13]
+       + "," + bytes[i + 14];
+}
+
+/* decode - turn a dataBinary byte array into { keys, lines, spans } */
+/*    where spans are the number of minutes of each line, from its key, */
+/*    and resolution is set for blocks of rollup lines */
+function decode(bytes) {
+   var result = { keys: [], lines: [], spans: [], resolution: 0 };
+
+   if (!bytes || bytes.length < HEADER_SIZE) {
+      throw new Error("Truncated binary block");
+   }
+   if (bytes[0] < 1 || bytes[0] > VERSION) {
+      throw new Error("Unsupported binary block version " + bytes[0]);
+   }
+   if (bytes[1] !== TYPE_MINUTE && bytes[1] !== TYPE_ROLLUP) {
+      throw new Error("Unsupported binary record type " + bytes[1]);
+   }
+
+   var count = bytes[3];
+   var key = getI32(bytes, 4);
+   var size = (bytes[1] === TYPE_ROLLUP) ? ROLLUP_SIZE : RECORD_SIZE;
+   if (bytes.length < HEADER_SIZE + count * size) {
+      throw new Error("Truncated binary block of " + count + " records");
+   }
+
+   if (bytes[1] === TYPE_ROLLUP) {
+      result.resolution = bytes[2];
+      for (var r = 0; r < count; r++) {
+         var j = HEADER_SIZE + r * ROLLUP_SIZE;
+         key += bytes[j];
+         result.keys.push(key);
+         result.lines.push(rollupLine(bytes, j, key));
+         result.spans.push(bytes[2]);
+         key += bytes[2] - 1;
+      }
+      return result;
+   }
+
+   for (var n = 0; n < count; n++) {
+      var i = HEADER_SIZE + n * RECORD_SIZE;
+      var span = (bytes[i + 3] & FLAG_RUN) ? getU16(bytes, i + 4) : 1;
+      key += bytes[i];
+      result.keys.push(key);
+      result.lines.push(minuteLine(bytes, i, key));
+      result.spans.push(span);
+      key += span - 1;
+   }
+
+   return result;
+}
+
+module.exports.decode = decode;
+module.exports.timestamp = timestamp;
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2017, Anthony Mamacos
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Background worker staging the minute history in the persistent ring,
+ * encoded as wire format blocks, so that the app can send them as soon
+ * as the phone asks for data instead of reading and encoding them then.
+ *
+ * The worker only appends blocks of complete minutes after
+ * ring.next_key, which is set by the app at the end of an export, keeps
+ * the last block before the present for a later collection as it may
+ * still grow, and stops once the ring is full. It leaves the ring alone between
+ * WORKER_MSG_LOCK and WORKER_MSG_UNLOCK, see persist_ring.h.
+ */
+
+#include "platform.h"
+
+#include "activity_index.h"
+#include "persist_ring.h"
+#include "wire_encoder.h"
+
+/* minutes of history read at once, within the worker heap */
+#define COLLECT_MINUTES 120
+/* minutes between two collections */
+#define COLLECT_INTERVAL 15
+
+static HealthMinuteData data[COLLECT_MINUTES];
+static struct activity_index activity;
+static uint8_t block[PERSIST_RING_CHUNK_SIZE];
+static struct persist_ring ring;
+static bool locked = false;
+
+struct collect_range {
+	time_t		first;
+	uint16_t	size;
+};
+
+static bool
+record_activity(HealthActivity activity_type, time_t start_time,
+    time_t end_time, void *context) {
+	struct collect_range *range = context;
+
+	return activity_index_add_interval(&activity, activity_type,
+	    start_time, end_time, range->first, range->size);
+}
+
+/* collect_step - stage the blocks of one read of history */
+/*    returns false when there is nothing more to stage for now */
+static bool
+collect_step(time_t now) {
+	struct collect_range range;
+	time_t present = now - now % 60;
+	time_t first = (time_t)ring.next_key * 60;
+	time_t last = present;
+	uint16_t index = 0;
+
+	if (last - first > COLLECT_MINUTES * 60)
+		last = first + COLLECT_MINUTES * 60;
+	if (last <= first) return false;
+
+	range.size = health_service_get_minute_history(data,
+	    COLLECT_MINUTES, &first, &last);
+	range.first = first;
+
+	if (!range.size) {
+		/* no history there, skip the window unless it is the present */
+		if (last >= present) return false;
+		ring.next_key = last / 60;
+		persist_ring_save(&ring);
+		return true;
+	}
+
+	activity_index_reset(&activity);
+	if (health_service_any_activity_accessible(HealthActivityMaskAll,
+	    first, last) == HealthServiceAccessibilityMaskAvailable) {
+		health_service_activities_iterate(HealthActivityMaskAll,
+		    first, last, HealthIterationDirectionFuture,
+		    &record_activity, &range);
+		activity_index_sort(&activity);
+	}
+
+	while (index < range.size) {
+		uint16_t end;
+		size_t size = wire_encode_minutes(block, sizeof block,
+		    data, &activity, index, range.size, first / 60, &end);
+
+		/* a block reaching the present may still grow, wait for it */
+		if (!size) return false;
+		if (end >= range.size && first + 60 * end >= present)
+			return false;
+		if (!persist_ring_push(&ring, block, size, first / 60 + end,
+		    false))
+			return false;
+		index = end;
+	}
+
+	return true;
+}
+
+/* collect - stage as many blocks as the ring accepts */
+static void
+collect(void) {
+	time_t now = time(0);
+
+	if (locked || !ring.next_key) return;
+	while (ring.count < PERSIST_RING_CHUNK_COUNT && collect_step(now));
+}
+
+static void
+tick_handler(struct tm *tick_time, TimeUnits units_changed) {
+	(void)units_changed;
+	if (tick_time->tm_min % COLLECT_INTERVAL == 0) collect();
+}
+
+static void
+message_handler(uint16_t type, AppWorkerMessage *message) {
+	(void)message;
+
+	if (type == WORKER_MSG_LOCK) {
+		AppWorkerMessage reply = { 0 };
+		locked = true;
+		app_worker_send_message(WORKER_MSG_LOCKED, &reply);
+	} else if (type == WORKER_MSG_UNLOCK) {
+		locked = false;
+		persist_ring_load(&ring);
+		collect();
+	}
+}
+
+static void
+worker_init(void) {
+	persist_ring_load(&ring);
+	app_worker_message_subscribe(&message_handler);
+	tick_timer_service_subscribe(MINUTE_UNIT, &tick_handler);
+	collect();
+}
+
+static void
+worker_deinit(void) {
+	tick_timer_service_unsubscribe();
+	app_worker_message_unsubscribe();
+}
+
+int
+main(void) {
+	worker_init();
+	worker_event_loop();
+	worker_deinit();
+	return 0;
+}